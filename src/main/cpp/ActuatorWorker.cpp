@@ -0,0 +1,64 @@
+/*
+    CAN I/O thread for actuator commands
+*/
+
+#include "ActuatorWorker.h"
+
+#include "Trace.h"
+
+ActuatorWorker::~ActuatorWorker()
+{
+    if (m_thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bRun = false;
+        }
+        m_wake.notify_one();
+        m_thread.join();
+    }
+}
+
+void ActuatorWorker::Start()
+{
+    m_bRun = true;
+    m_thread = std::thread(&ActuatorWorker::Run, this);
+}
+
+void ActuatorWorker::Wake()
+{
+    // The lock is held only to set the flag, the thread never holds it while sending
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bWoken = true;
+    }
+    m_wake.notify_one();
+}
+
+void ActuatorWorker::Run()
+{
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_bWoken || !m_bRun; });
+            if (!m_bRun)
+            {
+                break;
+            }
+            m_bWoken = false;
+        }
+
+        TRACE_SCOPE("ActuatorWorker::Drain");
+        for (size_t i = 0; i < m_numEntries; i++)
+        {
+            m_entries[i].m_drain(m_entries[i].m_mailbox);
+        }
+    }
+
+    // Anything posted before shutdown still goes out
+    for (size_t i = 0; i < m_numEntries; i++)
+    {
+        m_entries[i].m_drain(m_entries[i].m_mailbox);
+    }
+}
@@ -0,0 +1,345 @@
+/*
+    Log storage manager
+*/
+
+#include "LogStorage.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    struct Segment
+    {
+        unsigned m_sequence;
+        std::string m_path;
+        uint64_t m_size;
+    };
+
+    // Returns the sequence number of a segment file name, or false if the name is not <prefix>_<sequence>_...
+    bool ParseSequence(const char* name, const std::string& prefix, unsigned& sequence)
+    {
+        if (strncmp(name, prefix.c_str(), prefix.size()) != 0 || name[prefix.size()] != '_')
+        {
+            return false;
+        }
+
+        char* end = nullptr;
+        sequence = strtoul(name + prefix.size() + 1, &end, 10);
+
+        return end != name + prefix.size() + 1 && *end == '_';
+    }
+
+    std::vector<Segment> ListSegments(const std::string& directory, const std::string& prefix)
+    {
+        std::vector<Segment> segments;
+        DIR* dir = opendir(directory.c_str());
+        if (dir == nullptr)
+        {
+            return segments;
+        }
+
+        while (dirent* entry = readdir(dir))
+        {
+            Segment segment;
+            if (ParseSequence(entry->d_name, prefix, segment.m_sequence))
+            {
+                segment.m_path = directory + "/" + entry->d_name;
+                struct stat st;
+                segment.m_size = stat(segment.m_path.c_str(), &st) == 0 ? st.st_size : 0;
+                segments.push_back(segment);
+            }
+        }
+        closedir(dir);
+
+        // Oldest first
+        std::sort(segments.begin(), segments.end(), [](const Segment& a, const Segment& b) { return a.m_sequence < b.m_sequence; });
+
+        return segments;
+    }
+}
+
+LogFile::~LogFile()
+{
+    Close();
+}
+
+bool LogFile::Open(const std::string& path, size_t stagingSize)
+{
+    Close();
+
+    m_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (m_fd < 0)
+    {
+        printf("LogFile: cannot open %s: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    if (m_capacity != stagingSize)
+    {
+        m_buffer.reset(new char[stagingSize]);
+        m_capacity = stagingSize;
+    }
+    m_used = 0;
+    m_fileSize = 0;
+    m_sizeLimit = 0;
+    m_bFull = false;
+
+    return true;
+}
+
+void LogFile::Close()
+{
+    if (m_fd >= 0)
+    {
+        Flush();
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+void LogFile::Write(const void* data, size_t len)
+{
+    if (m_fd < 0 || m_bFull || OverLimit(len))
+    {
+        m_droppedBytes += len;
+        return;
+    }
+
+    if (m_used + len > m_capacity)
+    {
+        Flush();
+        if (m_used + len > m_capacity)
+        {
+            m_droppedBytes += len;
+            return;
+        }
+    }
+
+    memcpy(m_buffer.get() + m_used, data, len);
+    m_used += len;
+}
+
+void LogFile::Printf(const char* format, ...)
+{
+    if (m_fd < 0 || m_bFull)
+    {
+        return;
+    }
+
+    // Format straight into the staging buffer, flush and retry once if it did not fit
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        size_t space = m_capacity - m_used;
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf(m_buffer.get() + m_used, space, format, args);
+        va_end(args);
+
+        if (len < 0)
+        {
+            return;
+        }
+        if (OverLimit(len))
+        {
+            m_droppedBytes += len;
+            return;
+        }
+        if (static_cast<size_t>(len) < space)
+        {
+            m_used += len;
+            return;
+        }
+        if (attempt == 0)
+        {
+            Flush();
+        }
+        else
+        {
+            m_droppedBytes += len;
+        }
+    }
+}
+
+// Past the size limit the file takes nothing more, so it ends on a whole write
+bool LogFile::OverLimit(size_t len)
+{
+    if (m_sizeLimit != 0 && m_fileSize + m_used + len > m_sizeLimit)
+    {
+        m_bFull = true;
+    }
+    return m_bFull;
+}
+
+size_t LogFile::Flush()
+{
+    size_t written = 0;
+    while (m_fd >= 0 && written < m_used)
+    {
+        ssize_t n = write(m_fd, m_buffer.get() + written, m_used - written);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            printf("LogFile: write failed: %s\n", strerror(errno));
+            m_droppedBytes += m_used - written;
+            break;
+        }
+        written += n;
+    }
+
+    m_fileSize += written;
+    m_used = 0;
+
+    return written;
+}
+
+LogStorage::LogStorage(const Config& config)
+    : m_config(config)
+{
+    mkdir(m_config.m_directory.c_str(), 0755);
+
+    // Continue numbering after the newest segment already on disk
+    auto segments = ListSegments(m_config.m_directory, m_config.m_prefix);
+    if (!segments.empty())
+    {
+        m_sequence = segments.back().m_sequence + 1;
+    }
+}
+
+LogStorage::~LogStorage()
+{
+    Close();
+}
+
+bool LogStorage::Open(const char* tag, bool bBinary)
+{
+    Close();
+    EnforceBudget();
+
+    m_currentSequence = m_sequence++;
+    char base[64];
+    snprintf(base, sizeof(base), "_%05u_%s", m_currentSequence, tag);
+    std::string path = m_config.m_directory + "/" + m_config.m_prefix + base;
+    m_textPath = path + ".csv";
+    printf("Opening log %s\n", m_textPath.c_str());
+
+    bool bOk = m_text.Open(m_textPath, m_config.m_stagingSize);
+    if (bBinary)
+    {
+        bOk = m_binary.Open(path + ".bin", m_config.m_stagingSize) && bOk;
+    }
+
+    return bOk;
+}
+
+bool LogStorage::OpenExtra(const char* tag, const char* extension, uint64_t size, LogFile& file)
+{
+    EnforceBudget(size);
+
+    char base[64];
+    snprintf(base, sizeof(base), "_%05u_%s%s", m_sequence, tag, extension);
+    std::string path = m_config.m_directory + "/" + m_config.m_prefix + base;
+
+    // The open segment may still have data staged, that comes out of the budget too
+    uint64_t used = m_bytesOnDisk + m_text.GetStaged() + m_binary.GetStaged();
+    if (used >= m_config.m_diskBudget)
+    {
+        printf("Log budget: no room for %s\n", path.c_str());
+        return false;
+    }
+
+    m_sequence++;
+    printf("Opening %s\n", path.c_str());
+    if (!file.Open(path, m_config.m_stagingSize))
+    {
+        return false;
+    }
+    file.SetSizeLimit(m_config.m_diskBudget - used);
+
+    return true;
+}
+
+void LogStorage::CloseExtra(LogFile& file)
+{
+    file.Close();
+    m_bytesOnDisk += file.GetFileSize();
+}
+
+void LogStorage::Close()
+{
+    if (m_text.IsOpen())
+    {
+        printf("Closing log %s\n", m_textPath.c_str());
+    }
+
+    m_bytesOnDisk += m_text.GetStaged() + m_binary.GetStaged();
+    m_text.Close();
+    m_binary.Close();
+}
+
+void LogStorage::Poll(double now)
+{
+    bool bPeriodExpired = now - m_lastFlush >= m_config.m_flushPeriod;
+    if (bPeriodExpired)
+    {
+        m_lastFlush = now;
+    }
+
+    for (LogFile* file : { &m_text, &m_binary })
+    {
+        if (file->GetStaged() >= m_config.m_flushChunk || (bPeriodExpired && file->GetStaged() > 0))
+        {
+            FlushFile(*file);
+        }
+    }
+}
+
+void LogStorage::FlushFile(LogFile& file)
+{
+    m_bytesOnDisk += file.Flush();
+    if (m_bytesOnDisk > m_config.m_diskBudget)
+    {
+        EnforceBudget();
+    }
+}
+
+// Deletes the oldest closed segments until the directory fits the budget with reserve bytes to
+// spare. If the open segment alone is over budget it stops accepting data.
+void LogStorage::EnforceBudget(uint64_t reserve /* = 0 */)
+{
+    auto segments = ListSegments(m_config.m_directory, m_config.m_prefix);
+    uint64_t total = 0;
+    for (auto& segment : segments)
+    {
+        total += segment.m_size;
+    }
+
+    bool bCurrentOpen = m_text.IsOpen();
+    for (auto& segment : segments)
+    {
+        if (total + reserve <= m_config.m_diskBudget || (bCurrentOpen && segment.m_sequence >= m_currentSequence))
+        {
+            break;
+        }
+        printf("Log budget: deleting %s\n", segment.m_path.c_str());
+        unlink(segment.m_path.c_str());
+        total -= segment.m_size;
+    }
+
+    m_bytesOnDisk = total;
+    bool bFull = total > m_config.m_diskBudget;
+    m_text.SetFull(bFull);
+    m_binary.SetFull(bFull);
+}
@@ -8,6 +8,11 @@
 */
 
 #include "Logger.h"
+#include "Trace.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 
 const std::vector<char> c_vecLevels
 {
@@ -17,180 +22,661 @@ const std::vector<char> c_vecLevels
     , 'E'
 };
 
-Logger::Logger(const char *path, bool console_echo)
-    : m_fd(nullptr)
-    , m_path(path)
-    , m_console_echo(console_echo)
+namespace
 {
-    m_formattedIntData.reserve(500);
-    m_formattedDoubleData.reserve(500);
+    constexpr auto c_writerIdlePeriod = std::chrono::milliseconds(5);
+    // Segment tag when something is logged before the first openLog
+    constexpr const char* c_defaultTag = "boot";
+
+    /// Bytes Logger::writeSchema writes for schema
+    size_t SchemaSize(const LogStreamSchema& schema)
+    {
+        size_t size = sizeof(BinaryLog::c_tagSchema) + 4 * sizeof(uint16_t) + schema.m_name.size();
+        for (int i = 0; i < schema.m_numInts + schema.m_numDoubles; i++)
+        {
+            size += sizeof(uint16_t) + (i < (int)schema.m_fieldNames.size() ? schema.m_fieldNames[i].size() : ("field" + std::to_string(i)).size());
+        }
+        return size;
+    }
 }
 
-void Logger::openLog()
+Logger::Logger(const LogStorage::Config& storage, bool console_echo, bool async /* = false */, bool binaryData /* = false */)
+    : m_storage(storage)
+    , m_console_echo(console_echo)
+    , m_bAsync(async)
+    , m_bBinaryData(binaryData)
 {
-    printf("Opening log %s\n", m_path.c_str());
-    if (m_fd != nullptr)
+    m_loggerSiteId = RegisterSite("Logger", 0);
+
+    if (m_bAsync)
     {
-        printf("Log was open, closing\n");
-        closeLog();
+        m_ring = std::make_unique<LogRing>();
+        m_bRunWriter = true;
+        m_writerThread = std::thread(&Logger::writerLoop, this);
     }
+}
 
-    m_fd = fopen(m_path.c_str(), "a");
-    // CSV header for free form text logging
-    if (m_fd != nullptr)
-        fprintf(m_fd, "Timestamp,Level,Function,Line,Message\n");
+Logger::~Logger()
+{
+    if (m_bAsync)
+    {
+        m_bRunWriter = false;
+        m_writerThread.join();
+    }
 
-    if (m_console_echo)
-        printf("Timestamp,Level,Function,Line,Message\n");
+    closeFile();
 }
 
-Logger::~Logger()
+void Logger::openLog(const char* tag)
 {
-    closeLog();
+    m_logSegment++;
+    if (m_bAsync)
+    {
+        pushRecord(LogRecord::eOpen, m_timer.GetFPGATimestamp(), eInfo, m_loggerSiteId, tag, nullptr);
+    }
+    else
+    {
+        openFile(tag);
+    }
 }
 
 void Logger::closeLog()
 {
-    if (m_fd != nullptr)
+    m_logSegment++;
+    if (m_bAsync)
     {
-        printf("Closing log\n");
-        fclose(m_fd);
-        m_fd = nullptr;
+        pushRecord(LogRecord::eClose, m_timer.GetFPGATimestamp(), eInfo, m_loggerSiteId, "", nullptr);
     }
     else
     {
-        printf("No log was open\n");
+        closeFile();
+    }
+}
+
+// Starts a new segment, called by whichever thread owns the files
+void Logger::openFile(const char* tag)
+{
+    m_storage.Open(tag, m_bBinaryData);
+
+    // CSV headers for the site table rows and for free form text logging
+    m_sitesWritten = 0;
+    m_storage.Text().Printf("Site,Id,Function,Line,Instance\nTimestamp,Level,Site,Message\n");
+
+    if (m_console_echo)
+        printf("Timestamp,Level,Site,Message\n");
+
+    if (m_bBinaryData)
+    {
+        // Every file gets its own schema blocks so it can be decoded on its own
+        m_bSchemaWritten.fill(false);
+        m_storage.Binary().Write(BinaryLog::c_magic, sizeof(BinaryLog::c_magic));
+        m_storage.Binary().Write(&BinaryLog::c_version, sizeof(BinaryLog::c_version));
+    }
+}
+
+void Logger::closeFile()
+{
+    m_storage.Close();
+}
+
+int Logger::RegisterSite(const char* func, const int line, const std::string& instance /* = "" */)
+{
+    std::lock_guard<std::mutex> lock(m_sitesMutex);
+    return registerSiteLocked(func, line, instance);
+}
+
+int Logger::registerSiteLocked(const char* func, const int line, const std::string& instance)
+{
+    int siteId = m_numSites.load(std::memory_order_relaxed);
+    if (siteId >= c_maxSites)
+    {
+        printf("Logger: too many log sites, logging %s:%d as Logger\n", func, line);
+        return m_loggerSiteId;
     }
+
+    LogSite& site = m_sites[siteId];
+    site.m_func = func;
+    site.m_line = line;
+    site.m_instance = instance;
+    site.m_name = instance.empty() ? site.m_func : site.m_func + "[" + instance + "]";
+    // Publish the filled in site before any record that refers to it
+    m_numSites.store(siteId + 1, std::memory_order_release);
+
+    return siteId;
+}
+
+int Logger::findSite(const char* func, const int line)
+{
+    size_t hash = (reinterpret_cast<uintptr_t>(func) >> 3) * 31 + static_cast<size_t>(line);
+    size_t start = hash & (c_siteSlots - 1);
+
+    // Each func/line pair is only ever in the first free slot of its probe sequence, so the
+    // lookup can stop at an empty slot
+    size_t slot = start;
+    const char* slotFunc;
+    while ((slotFunc = m_siteSlots[slot].m_func.load(std::memory_order_acquire)) != nullptr)
+    {
+        if (slotFunc == func && m_siteSlots[slot].m_line == line)
+        {
+            return m_siteSlots[slot].m_siteId;
+        }
+        slot = (slot + 1) & (c_siteSlots - 1);
+    }
+
+    // Not seen yet. Another thread may claim slots while this one waits for the lock, probe again under it.
+    std::lock_guard<std::mutex> lock(m_sitesMutex);
+    for (slot = start; (slotFunc = m_siteSlots[slot].m_func.load(std::memory_order_relaxed)) != nullptr; slot = (slot + 1) & (c_siteSlots - 1))
+    {
+        if (slotFunc == func && m_siteSlots[slot].m_line == line)
+        {
+            return m_siteSlots[slot].m_siteId;
+        }
+    }
+
+    int siteId = registerSiteLocked(func, line, "");
+    // Only sites that got their own id take a slot, so at most c_maxSites of them are used and
+    // every probe ends at an empty one
+    if (siteId != m_loggerSiteId)
+    {
+        m_siteSlots[slot].m_line = line;
+        m_siteSlots[slot].m_siteId = siteId;
+        m_siteSlots[slot].m_func.store(func, std::memory_order_release);
+    }
+
+    return siteId;
 }
 
 void Logger::logMsg(ELogLevel level, const char* func, const int line, const char* msg, const char* msg2 /* = nullptr */)
 {
-    if (m_fd == nullptr)
+    logMsg(level, findSite(func, line), msg, msg2);
+}
+
+void Logger::logMsg(ELogLevel level, int siteId, const char* msg, const char* msg2 /* = nullptr */)
+{
+    TRACE_SCOPE("Logger::logMsg");
+    double timestamp = m_timer.GetFPGATimestamp();
+    if (m_bAsync)
     {
-        openLog();
+        pushRecord(LogRecord::eMessage, timestamp, level, siteId, msg, msg2);
+        return;
     }
 
-    if (m_fd != nullptr)
+    if (!m_storage.IsOpen())
     {
-        float timestamp = m_timer.GetFPGATimestamp();
+        openFile(c_defaultTag);
+    }
+
+    writeLine(timestamp, level, siteId, msg, msg2);
+    m_storage.Poll(timestamp);
+}
+
+void Logger::writeLine(double timestamp, ELogLevel level, int siteId, const char* msg, const char* msg2)
+{
+    if (m_storage.IsOpen())
+    {
+        writeNewSites();
+
+        LogFile& file = m_storage.Text();
         if (msg2 == nullptr)
         {
-	        fprintf(m_fd, "%.6f,%c,%s,%d,%s\n", timestamp, c_vecLevels[level], func, line, msg);
+	        file.Printf("%.6f,%c,%d,%s\n", timestamp, c_vecLevels[level], siteId, msg);
         }
         else
         {
-            fprintf(m_fd, "%.6f,%c,%s,%d,%s,%s\n", timestamp, c_vecLevels[level], func, line, msg, msg2);
+            file.Printf("%.6f,%c,%d,%s,%s\n", timestamp, c_vecLevels[level], siteId, msg, msg2);
         }
         
+        // The console is read by people, so it gets the site name instead of the id
         if (m_console_echo)
         {
+            const char* name = m_sites[siteId].m_name.c_str();
             if (msg2 == nullptr)
             {
-	            printf("%.6f,%c,%s,%d,%s\n", timestamp, c_vecLevels[level], func, line, msg);
+	            printf("%.6f,%c,%s,%s\n", timestamp, c_vecLevels[level], name, msg);
             }
             else
             {
-                printf("%.6f,%c,%s,%d,%s,%s\n", timestamp, c_vecLevels[level], func, line, msg, msg2);
+                printf("%.6f,%c,%s,%s,%s\n", timestamp, c_vecLevels[level], name, msg, msg2);
             }
         }
     }
 }
 
-void Logger::logData(const char* func, const int line, const vector<double*>& data)
+// Adds any sites registered since the last line to this file's id to name table
+void Logger::writeNewSites()
 {
-    formatData(data);
-    logMsg(eInfo, func, line, m_formattedDoubleData.c_str());
+    int numSites = m_numSites.load(std::memory_order_acquire);
+    for (; m_sitesWritten < numSites; m_sitesWritten++)
+    {
+        const LogSite& site = m_sites[m_sitesWritten];
+        m_storage.Text().Printf("Site,%d,%s,%d,%s\n", m_sitesWritten, site.m_func.c_str(), site.m_line, site.m_instance.c_str());
+    }
 }
 
-void Logger::logData(const char* func, const int line, const vector<int*>& data)
+// Robot thread side of the async logger. Never blocks: if the writer has fallen behind the record is counted and dropped.
+// A message longer than one record goes out as ePart records of c_msgSize chars each, the last record has the type.
+void Logger::pushRecord(LogRecord::EType type, double timestamp, ELogLevel level, int siteId, const char* msg, const char* msg2)
 {
-    formatData(data);
-    logMsg(eInfo, func, line, m_formattedIntData.c_str());
+    // msg and msg2 are sent as one message with a comma between them
+    const char* pieces[] = { msg, msg2 != nullptr ? "," : "", msg2 != nullptr ? msg2 : "" };
+    size_t piece = 0;
+    const char* src = pieces[0];
+    bool bSplit = false;
+
+    for (;;)
+    {
+        LogRecord* rec = m_ring->BeginPush();
+        if (rec == nullptr)
+        {
+            // Parts already sent are thrown away by the writer when the next record is not their continuation
+            m_droppedRecords.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        rec->m_level = level;
+        rec->m_siteId = siteId;
+        rec->m_timestamp = timestamp;
+
+        char* out = rec->m_msg;
+        const char* end = rec->m_msg + LogRecord::c_msgSize;
+        while (out < end)
+        {
+            if (*src != '\0')
+            {
+                *out++ = *src++;
+            }
+            else if (++piece < std::size(pieces))
+            {
+                src = pieces[piece];
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        if (out < end)
+        {
+            *out = '\0';
+            rec->m_type = type;
+            m_ring->CommitPush();
+            if (bSplit)
+            {
+                m_splitRecords.fetch_add(1, std::memory_order_relaxed);
+            }
+            return;
+        }
+
+        rec->m_type = LogRecord::ePart;
+        m_ring->CommitPush();
+        bSplit = true;
+    }
 }
 
-void Logger::logData(const char* func, const int line, const vector<int*>& dataInt, const vector<double*>& dataDouble)
+void Logger::writerLoop()
+{
+    while (m_bRunWriter.load(std::memory_order_acquire))
+    {
+        drainRing();
+        // Disk writes happen here, on the writer thread, in staging buffer sized chunks
+        m_storage.Poll(m_timer.GetFPGATimestamp());
+        std::this_thread::sleep_for(c_writerIdlePeriod);
+    }
+
+    // Pick up anything queued before shutdown, including the final close
+    drainRing();
+}
+
+// Text of a record, with any ePart records before it in front. Writer thread only.
+const char* Logger::assembleMessage(LogRecord* rec)
+{
+    if (m_pendingMsg.empty())
+    {
+        return rec->m_msg;
+    }
+
+    // Parts whose last record was dropped are not this record's
+    if (rec->m_siteId != m_pendingSiteId || rec->m_timestamp != m_pendingTimestamp)
+    {
+        m_pendingMsg.clear();
+        return rec->m_msg;
+    }
+
+    m_pendingMsg += rec->m_msg;
+    return m_pendingMsg.c_str();
+}
+
+void Logger::drainRing()
+{
+    while (LogRecord* rec = m_ring->Front())
+    {
+        if (rec->m_type == LogRecord::ePart)
+        {
+            if (!m_pendingMsg.empty() && (rec->m_siteId != m_pendingSiteId || rec->m_timestamp != m_pendingTimestamp))
+            {
+                m_pendingMsg.clear();
+            }
+            m_pendingSiteId = rec->m_siteId;
+            m_pendingTimestamp = rec->m_timestamp;
+            m_pendingMsg.append(rec->m_msg, LogRecord::c_msgSize);
+            m_ring->Pop();
+            continue;
+        }
+
+        const char* msg = rec->m_type == LogRecord::eData ? rec->m_msg : assembleMessage(rec);
+        switch (rec->m_type)
+        {
+        case LogRecord::eOpen:
+            openFile(msg);
+            break;
+
+        case LogRecord::eClose:
+            closeFile();
+            break;
+
+        case LogRecord::eMessage:
+            if (!m_storage.IsOpen())
+            {
+                openFile(c_defaultTag);
+            }
+            writeLine(rec->m_timestamp, rec->m_level, rec->m_siteId, msg, nullptr);
+            break;
+
+        case LogRecord::eData:
+            if (!m_storage.IsOpen())
+            {
+                openFile(c_defaultTag);
+            }
+            {
+                const LogStreamSchema& schema = m_streams[rec->m_streamId];
+                storeData(rec->m_streamId, rec->m_timestamp, rec->m_payload, rec->m_payload + BinaryLog::PayloadSize(schema.m_numInts, 0));
+            }
+            break;
+
+        case LogRecord::eTrigger:
+            dumpFlightRecorder(msg, rec->m_timestamp);
+            break;
+
+        case LogRecord::ePart:
+            break;
+        }
+        m_pendingMsg.clear();
+        m_ring->Pop();
+    }
+
+    uint32_t dropped = m_droppedRecords.load(std::memory_order_relaxed);
+    if (dropped != m_reportedDrops && m_storage.IsOpen())
+    {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "Dropped %u log records", dropped - m_reportedDrops);
+        writeLine(m_timer.GetFPGATimestamp(), eWarn, m_loggerSiteId, msg, nullptr);
+        m_reportedDrops = dropped;
+    }
+}
+
+// Called from the robot thread the first time a LogDataT stream is logged
+int Logger::registerStream(const char* name, const std::vector<std::string>& fieldNames, size_t numInts, size_t numDoubles, double sampleRate, bool bSummary /* = false */)
 {
-    formatData(dataInt);
-    formatData(dataDouble);
-    logMsg(eInfo, func, line, m_formattedIntData.c_str(), m_formattedDoubleData.c_str());
+    int streamId = m_numStreams.load(std::memory_order_relaxed);
+    if (streamId >= c_maxStreams || BinaryLog::PayloadSize(numInts, numDoubles) > LogRecord::c_msgSize)
+    {
+        printf("Logger: cannot add binary stream %s, logging it as text\n", name);
+        return -1;
+    }
+
+    LogStreamSchema& schema = m_streams[streamId];
+    schema.m_name = name;
+    schema.m_fieldNames = fieldNames;
+    schema.m_numInts = numInts;
+    schema.m_numDoubles = numDoubles;
+    schema.m_bSummary = bSummary;
+    schema.m_sampleRate = sampleRate > 0.0 ? sampleRate : m_defaultSampleRate;
+    // Publish the filled in schema before any record that refers to it
+    m_numStreams.store(streamId + 1, std::memory_order_release);
+
+    return streamId;
 }
 
-void Logger::formatData(const vector<double*>& data)
+void Logger::logBinary(int streamId, const int* ints, const double* doubles)
 {
-	//									   123456789
-    constexpr int c_charsPerDouble = 9;	// -123.000, most will be small but allow for some to be larger
-    const size_t c_numDataPts = data.size();
-    const int c_totalSz = c_charsPerDouble * c_numDataPts - 1;  // -1 to truncate the terminating null
-    m_formattedDoubleData.resize(c_totalSz);
-    char* out = const_cast<char*>(m_formattedDoubleData.c_str());
+    TRACE_SCOPE("Logger::logBinary");
+    double timestamp = m_timer.GetFPGATimestamp();
+    const LogStreamSchema& schema = m_streams[streamId];
+    size_t intBytes = BinaryLog::PayloadSize(schema.m_numInts, 0);
+    size_t doubleBytes = BinaryLog::PayloadSize(0, schema.m_numDoubles);
+
+    if (!m_bAsync)
+    {
+        if (!m_storage.IsOpen())
+        {
+            openFile(c_defaultTag);
+        }
+        storeData(streamId, timestamp, ints, doubles);
+        m_storage.Poll(timestamp);
+        return;
+    }
 
-    for (size_t i = 0; i < c_numDataPts; i++)
+    LogRecord* rec = m_ring->BeginPush();
+    if (rec == nullptr)
     {
-        //out += sprintf(out, "%.3f%s", *data[i], i == c_numDataPts - 1 ? "" : ",");
-        out += sprintf(out, "%.3f%c", *data[i], i < c_numDataPts - 1 ? ',' : ' ');
- 		if (out - m_formattedDoubleData.c_str() >= c_totalSz)
-		{
-			break;
-		}
+        m_droppedRecords.fetch_add(1, std::memory_order_relaxed);
+        return;
     }
+
+    rec->m_type = LogRecord::eData;
+    rec->m_streamId = streamId;
+    rec->m_timestamp = timestamp;
+    memcpy(rec->m_payload, ints, intBytes);
+    memcpy(rec->m_payload + intBytes, doubles, doubleBytes);
+    m_ring->CommitPush();
+}
+
+void Logger::SetFlightRecorder(double windowSeconds, double defaultSampleRate, int decimation)
+{
+    m_flightRecorder.SetWindow(windowSeconds);
+    m_defaultSampleRate = defaultSampleRate;
+    m_dataDecimation = decimation > 0 ? decimation : 1;
+    m_triggerHoldoff = windowSeconds;
+}
+
+void Logger::PublishDashboard()
+{
+    TRACE_SCOPE("Logger::PublishDashboard");
+    m_telemetry.Publish(m_timer.GetFPGATimestamp());
 }
 
-void Logger::formatData(const vector<double>& data)
+void Logger::TriggerFlightRecorder(const char* reason)
 {
-	//									   123456789
-    constexpr int c_charsPerDouble = 9;	// -123.000, most will be small but allow for some to be larger
-    const size_t c_numDataPts = data.size();
-    const int c_totalSz = c_charsPerDouble * c_numDataPts - 1;  // -1 to truncate the terminating null
-    m_formattedDoubleData.resize(c_totalSz);
-    char* out = const_cast<char*>(m_formattedDoubleData.c_str());
+    // A persisting fault keeps firing, only dump again once the previous window has been replaced
+    double timestamp = m_timer.GetFPGATimestamp();
+    if (timestamp - m_lastTrigger < m_triggerHoldoff)
+    {
+        return;
+    }
+    m_lastTrigger = timestamp;
 
-    for (size_t i = 0; i < c_numDataPts; i++)
+    if (m_bAsync)
     {
-        //out += sprintf(out, "%.3f%s", data[i], i == c_numDataPts - 1 ? "" : ",");
-        out += sprintf(out, "%.3f%c", data[i], i < c_numDataPts - 1 ? ',' : ' ');
- 		if (out - m_formattedDoubleData.c_str() >= c_totalSz)
-		{
-			break;
-		}
+        pushRecord(LogRecord::eTrigger, timestamp, eWarn, m_loggerSiteId, reason, nullptr);
+    }
+    else
+    {
+        dumpFlightRecorder(reason, timestamp);
     }
 }
 
-void Logger::formatData(const vector<int*>& data)
+// Every sample goes into the flight recorder, every m_dataDecimation'th one into the log.
+// Summary streams are logged whole: a window's summaries arrive back to back, one per field.
+void Logger::storeData(int streamId, double timestamp, const void* ints, const void* doubles)
 {
-    //									   1234567
-    constexpr int c_charsPerInt = 7;	// _ _ _0,
-    const size_t c_numDataPts = data.size();
-    const int c_totalSz = c_charsPerInt * c_numDataPts - 1;  // -1 to truncate the terminating null
-    m_formattedIntData.resize(c_totalSz);
-    char* out = const_cast<char*>(m_formattedIntData.c_str());
+    const LogStreamSchema& schema = m_streams[streamId];
+    if (schema.m_bSummary)
+    {
+        writeData(streamId, timestamp, ints, doubles);
+        return;
+    }
 
-    for (size_t i = 0; i < c_numDataPts; i++)
+    if (m_flightRecorder.IsEnabled())
     {
-        //out += sprintf(out, "%6d%s", *data[i], i == c_numDataPts - 1 ? "" : ",");
-        out += sprintf(out, "%6d%c", *data[i], i < c_numDataPts - 1 ? ',' : ' ');
-        if (out - m_formattedIntData.c_str() >= c_totalSz)
+        m_flightRecorder.Record(streamId, schema.m_sampleRate, timestamp
+                              , ints, BinaryLog::PayloadSize(schema.m_numInts, 0)
+                              , doubles, BinaryLog::PayloadSize(0, schema.m_numDoubles));
+    }
+
+    unsigned& count = m_decimationCount[streamId];
+    if (count == 0)
+    {
+        writeData(streamId, timestamp, ints, doubles);
+    }
+    count = (count + 1) % m_dataDecimation;
+}
+
+// One record into the current .bin file, preceded by its stream's schema the first time
+void Logger::writeData(int streamId, double timestamp, const void* ints, const void* doubles)
+{
+    LogFile& file = m_storage.Binary();
+    if (file.IsOpen())
+    {
+        if (!m_bSchemaWritten[streamId])
         {
-            break;
+            writeSchema(file, streamId);
+            m_bSchemaWritten[streamId] = true;
         }
+        writeBinaryRecord(file, streamId, timestamp, ints, doubles);
     }
 }
 
-void Logger::formatData(const vector<int>& data)
+// Writes the flight recorder window of every stream to its own file
+void Logger::dumpFlightRecorder(const char* reason, double timestamp)
 {
-    //									   1234567
-    constexpr int c_charsPerInt = 7;	// _ _ _0,
-    const size_t c_numDataPts = data.size();
-    const int c_totalSz = c_charsPerInt * c_numDataPts - 1;  // -1 to truncate the terminating null
-    m_formattedIntData.resize(c_totalSz);
-    char* out = const_cast<char*>(m_formattedIntData.c_str());
+    if (!m_flightRecorder.IsEnabled() || m_flightRecorder.GetNumStreams() == 0)
+    {
+        return;
+    }
 
-    for (size_t i = 0; i < c_numDataPts; i++)
+    // Size of the dump, so the disk budget can make room for it
+    uint64_t size = BinaryLog::c_fileHeaderSize;
+    for (int streamId = 0; streamId < m_flightRecorder.GetNumStreams(); streamId++)
     {
-        //out += sprintf(out, "%6d%s", data[i], i == c_numDataPts - 1 ? "" : ",");
-        out += sprintf(out, "%6d%c", data[i], i < c_numDataPts - 1 ? ',' : ' ');
-        if (out - m_formattedIntData.c_str() >= c_totalSz)
+        const LogStreamSchema& schema = m_streams[streamId];
+        if (!schema.m_bSummary)
         {
-            break;
+            size += SchemaSize(schema)
+                  + m_flightRecorder.GetCount(streamId) * (BinaryLog::c_recordHeaderSize + BinaryLog::PayloadSize(schema.m_numInts, schema.m_numDoubles));
+        }
+    }
+
+    LogFile file;
+    if (!m_storage.OpenExtra("fault", ".bin", size, file))
+    {
+        return;
+    }
+
+    file.Write(BinaryLog::c_magic, sizeof(BinaryLog::c_magic));
+    file.Write(&BinaryLog::c_version, sizeof(BinaryLog::c_version));
+    for (int streamId = 0; streamId < m_flightRecorder.GetNumStreams(); streamId++)
+    {
+        const LogStreamSchema& schema = m_streams[streamId];
+        if (schema.m_bSummary)
+        {
+            continue;
         }
+
+        size_t intBytes = BinaryLog::PayloadSize(schema.m_numInts, 0);
+        writeSchema(file, streamId);
+        m_flightRecorder.ForEachSample(streamId, [&](double sampleTime, const unsigned char* payload)
+        {
+            writeBinaryRecord(file, streamId, sampleTime, payload, payload + intBytes);
+        });
+    }
+    m_storage.CloseExtra(file);
+
+    char msg[LogRecord::c_msgSize];
+    snprintf(msg, sizeof(msg), "Flight recorder dumped: %s", reason);
+    writeLine(timestamp, eWarn, m_loggerSiteId, msg, nullptr);
+}
+
+void Logger::writeSchema(LogFile& file, int streamId)
+{
+    const LogStreamSchema& schema = m_streams[streamId];
+
+    auto writeU16 = [&file](size_t value)
+    {
+        uint16_t v = value;
+        file.Write(&v, sizeof(v));
+    };
+    auto writeString = [&file, &writeU16](const std::string& str)
+    {
+        writeU16(str.size());
+        file.Write(str.data(), str.size());
+    };
+
+    file.Write(&BinaryLog::c_tagSchema, sizeof(BinaryLog::c_tagSchema));
+    writeU16(streamId);
+    writeU16(schema.m_numInts);
+    writeU16(schema.m_numDoubles);
+    writeString(schema.m_name);
+    for (int i = 0; i < schema.m_numInts + schema.m_numDoubles; i++)
+    {
+        // Header names are optional for the int fields, fall back to a generic name
+        writeString(i < (int)schema.m_fieldNames.size() ? schema.m_fieldNames[i] : "field" + std::to_string(i));
+    }
+}
+
+void Logger::writeBinaryRecord(LogFile& file, int streamId, double timestamp, const void* ints, const void* doubles)
+{
+    const LogStreamSchema& schema = m_streams[streamId];
+    size_t intBytes = BinaryLog::PayloadSize(schema.m_numInts, 0);
+    size_t doubleBytes = BinaryLog::PayloadSize(0, schema.m_numDoubles);
+
+    // Assemble the fixed width record so it is staged in a single write
+    unsigned char buf[BinaryLog::c_recordHeaderSize + LogRecord::c_msgSize];
+    unsigned char* out = buf;
+    uint16_t id = streamId;
+    int64_t timestampUs = static_cast<int64_t>(timestamp * 1.0e6);
+    *out++ = BinaryLog::c_tagRecord;
+    memcpy(out, &id, sizeof(id));
+    out += sizeof(id);
+    memcpy(out, &timestampUs, sizeof(timestampUs));
+    out += sizeof(timestampUs);
+    memcpy(out, ints, intBytes);
+    out += intBytes;
+    memcpy(out, doubles, doubleBytes);
+    out += doubleBytes;
+
+    file.Write(buf, out - buf);
+}
+
+void Logger::logData(const char* func, const int line, const vector<double*>& data)
+{
+    char formatted[c_formatBufferSize];
+    if (!formatData(formatted, data))
+    {
+        logMsg(eError, func, line, "Too many data fields to format");
+        return;
+    }
+    logMsg(eInfo, func, line, formatted);
+}
+
+void Logger::logData(const char* func, const int line, const vector<int*>& data)
+{
+    char formatted[c_formatBufferSize];
+    if (!formatData(formatted, data))
+    {
+        logMsg(eError, func, line, "Too many data fields to format");
+        return;
+    }
+    logMsg(eInfo, func, line, formatted);
+}
+
+void Logger::logData(const char* func, const int line, const vector<int*>& dataInt, const vector<double*>& dataDouble)
+{
+    char formattedInts[c_formatBufferSize];
+    char formattedDoubles[c_formatBufferSize];
+    if (!formatData(formattedInts, dataInt) || !formatData(formattedDoubles, dataDouble))
+    {
+        logMsg(eError, func, line, "Too many data fields to format");
+        return;
     }
+    logMsg(eInfo, func, line, formattedInts, formattedDoubles);
 }
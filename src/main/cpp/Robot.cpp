@@ -7,13 +7,39 @@
 
 #include "Robot.h"
 
+#include <frc/RobotController.h>
+#include <frc/shuffleboard/Shuffleboard.h>
 #include <frc/smartdashboard/SmartDashboard.h>
 #include <frc2/command/CommandScheduler.h>
 
+#include "Trace.h"
+
+namespace
+{
+    LogStorage::Config MakeLogStorageConfig()
+    {
+        LogStorage::Config config;
+        config.m_directory = "/home/lvuser/logs";
+        config.m_prefix = "swerve";
+        return config;
+    }
+}
+
 Robot::Robot()
-    : m_log("/tmp/logfile.csv", false)
+    : m_log(MakeLogStorageConfig(), false, true, true)
     , m_container(m_log)
 {
+    m_log.SetFlightRecorder(LogConstants::kFlightRecorderSeconds, LogConstants::kLoopsPerSecond, LogConstants::kDataDecimation);
+
+    m_nteDumpFlightRecorder = frc::Shuffleboard::GetTab("Logging")
+                                .Add("Dump flight recorder", false)
+                                .WithWidget(frc::BuiltInWidgets::kToggleButton)
+                                .GetEntry();
+
+    m_nteWriteTrace = frc::Shuffleboard::GetTab("Logging")
+                        .Add("Write trace (disabled)", false)
+                        .WithWidget(frc::BuiltInWidgets::kToggleButton)
+                        .GetEntry();
 }
 
 void Robot::RobotInit()
@@ -30,7 +56,20 @@ void Robot::RobotInit()
  */
 void Robot::RobotPeriodic()
 {
-    frc2::CommandScheduler::GetInstance().Run();
+    TRACE_SCOPE("Robot::RobotPeriodic");
+    TRACE_CALL("CommandScheduler::Run", frc2::CommandScheduler::GetInstance().Run());
+    m_log.PublishDashboard();
+
+    if (m_nteDumpFlightRecorder.GetBoolean(false))
+    {
+        m_nteDumpFlightRecorder.SetBoolean(false);
+        m_log.TriggerFlightRecorder("dashboard");
+    }
+
+    if (frc::RobotController::IsBrownedOut())
+    {
+        m_log.TriggerFlightRecorder("brownout");
+    }
 }
 
 /**
@@ -41,11 +80,18 @@ void Robot::RobotPeriodic()
 void Robot::DisabledInit()
 {
     m_log.logMsg(eInfo, __func__, __LINE__, "Disabling");
-    m_log.closeLog();
+    // Subsystems keep logging while disabled, so give that its own segment
+    m_log.openLog("disabled");
 }
 
 void Robot::DisabledPeriodic()
 {
+    // Writing the trace takes far longer than a loop, so only while disabled
+    if (m_nteWriteTrace.GetBoolean(false))
+    {
+        m_nteWriteTrace.SetBoolean(false);
+        TraceBuffer::WriteChromeTrace(LogConstants::kTraceFile);
+    }
 }
 
 /**
@@ -54,7 +100,7 @@ void Robot::DisabledPeriodic()
  */
 void Robot::AutonomousInit()
 {
-    m_log.openLog();
+    m_log.openLog("auto");
     m_log.logMsg(eInfo, __func__, __LINE__, "Starting Autonomous");
 
     m_autonomousCommand = m_container.GetAutonomousCommand();
@@ -70,7 +116,7 @@ void Robot::AutonomousPeriodic()
 
 void Robot::TeleopInit()
 {
-    m_log.openLog();
+    m_log.openLog("teleop");
     m_log.logMsg(eInfo, __func__, __LINE__, "Starting Teleop");
 
     // This makes sure that the autonomous stops running when
@@ -7,6 +7,7 @@
 
 #include "RobotContainer.h"
 
+#include <frc/Filesystem.h>
 #include <frc/controller/PIDController.h>
 #include <frc/geometry/Translation2d.h>
 #include <frc/shuffleboard/Shuffleboard.h>
@@ -17,9 +18,11 @@
 #include <frc2/command/SwerveControllerCommand.h>
 #include <frc2/command/button/JoystickButton.h>
 #include <units/units.h>
+#include <wpi/SmallString.h>
 
 #include "Constants.h"
 #include "subsystems/DriveSubsystem.h"
+#include "TrajectoryCache.h"
 
 using namespace DriveConstants;
 
@@ -32,6 +35,8 @@ RobotContainer::RobotContainer(Logger& log)
     // Configure the button bindings
     ConfigureButtonBindings();
 
+    LoadTrajectories();
+
     // Set up default drive command
     m_drive.SetDefaultCommand(frc2::RunCommand(
         [this] {
@@ -122,9 +127,11 @@ void RobotContainer::ConfigureButtonBindings()
     // Configure your button bindings here
 }
 
-frc2::Command *RobotContainer::GetAutonomousCommand()
+void RobotContainer::LoadTrajectories()
 {
-    m_drive.ResetOdometry(frc::Pose2d(0_m, 0_m, frc::Rotation2d(0_deg)));
+    wpi::SmallString<64> deployDirectory;
+    frc::filesystem::GetDeployDirectory(deployDirectory);
+    TrajectoryCache cache(std::string(deployDirectory.str()) + "/" + AutoConstants::kTrajectoryCacheFile);
 
     // Set up config for trajectory
     frc::TrajectoryConfig config(AutoConstants::kMaxSpeed,
@@ -133,7 +140,7 @@ frc2::Command *RobotContainer::GetAutonomousCommand()
     config.SetKinematics(m_drive.kDriveKinematics);
 
     // An example trajectory to follow.  All units in meters.
-    auto exampleTrajectory = frc::TrajectoryGenerator::GenerateTrajectory(
+    m_exampleTrajectory = cache.Get(
         // Start at the origin facing the +X direction
         frc::Pose2d(0_m, 0_m, frc::Rotation2d(0_deg)),
         // Pass through these two interior waypoints, making an 's' curve path
@@ -144,7 +151,7 @@ frc2::Command *RobotContainer::GetAutonomousCommand()
         config
     );
 
-    auto exampleTrajectory2 = frc::TrajectoryGenerator::GenerateTrajectory(
+    m_exampleTrajectory2 = cache.Get(
         // Start at the origin facing the +X direction
         frc::Pose2d(0_m, 0_m, frc::Rotation2d(0_deg)),
         // Pass through these two interior waypoints, making an 's' curve path
@@ -155,8 +162,17 @@ frc2::Command *RobotContainer::GetAutonomousCommand()
         config
     );
 
+    // Only writes when something had to be generated, i.e. on the first boot after a change
+    cache.Save();
+    printf("Trajectories: %u from cache, %u generated\n", cache.GetHits(), cache.GetMisses());
+}
+
+frc2::Command *RobotContainer::GetAutonomousCommand()
+{
+    m_drive.ResetOdometry(frc::Pose2d(0_m, 0_m, frc::Rotation2d(0_deg)));
+
     frc2::SwerveControllerCommand<4> swerveControllerCommand(
-        exampleTrajectory, [this]() { return m_drive.GetPose(); },
+        m_exampleTrajectory, [this]() { return m_drive.GetPose(); },
 
         m_drive.kDriveKinematics,
 
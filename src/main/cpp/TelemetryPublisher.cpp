@@ -0,0 +1,62 @@
+/*
+    Telemetry publisher
+*/
+
+#include "TelemetryPublisher.h"
+
+#include <cmath>
+
+TelemetryPublisher::TelemetryPublisher(size_t entriesPerLoop)
+    : m_entriesPerLoop(entriesPerLoop)
+{
+}
+
+void TelemetryPublisher::AddField(nt::NetworkTableEntry entry, const double* value, double deadband, double period)
+{
+    Field field;
+    field.m_entry = entry;
+    field.m_double = value;
+    field.m_deadband = deadband;
+    field.m_period = period;
+    m_fields.push_back(field);
+}
+
+void TelemetryPublisher::AddField(nt::NetworkTableEntry entry, const int* value, double deadband, double period)
+{
+    Field field;
+    field.m_entry = entry;
+    field.m_int = value;
+    field.m_deadband = deadband;
+    field.m_period = period;
+    m_fields.push_back(field);
+}
+
+void TelemetryPublisher::Publish(double now)
+{
+    size_t numFields = m_fields.size();
+    size_t sent = 0;
+
+    // Look at every field at most once per call
+    for (size_t checked = 0; checked < numFields && sent < m_entriesPerLoop; checked++)
+    {
+        Field& field = m_fields[m_next];
+        m_next = (m_next + 1) % numFields;
+
+        if (field.m_bPublished && now - field.m_lastTime < field.m_period)
+        {
+            continue;
+        }
+
+        double value = field.m_double != nullptr ? *field.m_double : (double)*field.m_int;
+        if (field.m_bPublished && fabs(value - field.m_lastValue) <= field.m_deadband)
+        {
+            continue;
+        }
+
+        field.m_entry.SetDouble(value);
+        field.m_lastValue = value;
+        field.m_lastTime = now;
+        field.m_bPublished = true;
+        sent++;
+    }
+}
@@ -0,0 +1,113 @@
+/*
+    Timeline tracing
+*/
+
+#include "Trace.h"
+
+#include <stdio.h>
+
+#include <array>
+#include <mutex>
+
+namespace
+{
+    std::mutex g_namesMutex;
+    std::array<const char*, TraceBuffer::c_maxNames> g_names;
+    std::atomic<int> g_numNames{0};
+}
+
+TraceBuffer::Event TraceBuffer::s_events[TraceBuffer::c_numEvents];
+
+int TraceBuffer::RegisterName(const char* name)
+{
+    std::lock_guard<std::mutex> lock(g_namesMutex);
+    int id = g_numNames.load(std::memory_order_relaxed);
+    if (id >= c_maxNames)
+    {
+        printf("TraceBuffer: too many names, %s shares the last id\n", name);
+        return c_maxNames - 1;
+    }
+
+    g_names[id] = name;
+    g_numNames.store(id + 1, std::memory_order_release);
+
+    return id;
+}
+
+bool TraceBuffer::WriteChromeTrace(const char* path)
+{
+    FILE* out = fopen(path, "w");
+    if (out == nullptr)
+    {
+        printf("TraceBuffer: cannot open %s\n", path);
+        return false;
+    }
+
+    // Stop recording so the ring is not overwritten while it is written out. Records already
+    // past the enabled check still land, the sequence numbers catch those.
+    bool bWasEnabled = s_bEnabled.exchange(false);
+    uint32_t next = s_next.load(std::memory_order_acquire);
+    uint32_t count = next < c_numEvents ? next : c_numEvents;
+    int numNames = g_numNames.load(std::memory_order_acquire);
+
+    // The ring may start in the middle of a scope, drop ends that have no begin
+    std::array<int, 256> depth{};
+    uint64_t startNs = 0;
+    uint32_t written = 0;
+    bool bFirst = true;
+
+    fprintf(out, "{\"traceEvents\":[\n");
+    for (uint32_t i = next - count; i != next; i++)
+    {
+        // Seqlock read: an event still being written, or overwritten since, has another sequence number
+        const Event& slot = s_events[i & (c_numEvents - 1)];
+        uint32_t seq = slot.m_seq.load(std::memory_order_acquire);
+        uint64_t timeNs = slot.m_timeNs.load(std::memory_order_relaxed);
+        uint32_t info = slot.m_info.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq != i + 1 || slot.m_seq.load(std::memory_order_relaxed) != seq)
+        {
+            continue;
+        }
+
+        int id = info & 0xffff;
+        uint8_t phase = (info >> 16) & 0xff;
+        uint8_t thread = info >> 24;
+        if (id >= numNames)
+        {
+            continue;
+        }
+        if (phase == eBegin)
+        {
+            depth[thread]++;
+        }
+        else if (depth[thread] == 0)
+        {
+            continue;
+        }
+        else
+        {
+            depth[thread]--;
+        }
+
+        if (bFirst)
+        {
+            startNs = timeNs;
+        }
+        fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}"
+              , bFirst ? "" : ",\n"
+              , g_names[id]
+              , phase == eBegin ? 'B' : 'E'
+              , (int64_t)(timeNs - startNs) * 1.0e-3
+              , thread);
+        bFirst = false;
+        written++;
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(out);
+
+    s_bEnabled.store(bWasEnabled);
+    printf("TraceBuffer: wrote %u events to %s\n", written, path);
+
+    return true;
+}
@@ -0,0 +1,296 @@
+/*
+    Generated trajectories cached in a binary file
+*/
+
+#include "TrajectoryCache.h"
+
+#include <frc/trajectory/TrajectoryGenerator.h>
+
+#include <cmath>
+#include <limits>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Constants.h"
+#include "Trace.h"
+
+using namespace TrajectoryFile;
+
+namespace
+{
+    /// FNV-1a, 64 bit
+    class KeyHash
+    {
+    public:
+        void Add(double value)
+        {
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            for (int i = 0; i < 8; i++)
+            {
+                m_hash ^= (bits >> (8 * i)) & 0xFF;
+                m_hash *= c_prime;
+            }
+        }
+
+        void Add(const frc::Pose2d& pose)
+        {
+            Add(pose.Translation().X().to<double>());
+            Add(pose.Translation().Y().to<double>());
+            Add(pose.Rotation().Radians().to<double>());
+        }
+
+        uint64_t Get() const { return m_hash; }
+
+    private:
+        static constexpr uint64_t c_prime = 0x100000001B3ull;
+        uint64_t m_hash = 0xCBF29CE484222325ull;
+    };
+
+    bool WriteAll(int fd, const void* data, size_t len)
+    {
+        const char* p = static_cast<const char*>(data);
+        while (len > 0)
+        {
+            ssize_t written = write(fd, p, len);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            p += written;
+            len -= written;
+        }
+
+        return true;
+    }
+}
+
+TrajectoryCache::TrajectoryCache(const std::string& path)
+    : m_path(path)
+{
+    int fd = open(m_path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(Header))
+    {
+        void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            m_map = static_cast<const uint8_t*>(map);
+            m_mapSize = st.st_size;
+        }
+    }
+    close(fd);
+
+    if (m_map == nullptr)
+    {
+        return;
+    }
+
+    const Header* header = reinterpret_cast<const Header*>(m_map);
+    size_t entriesEnd = sizeof(Header) + static_cast<size_t>(header->m_numTrajectories) * sizeof(Entry);
+    if (memcmp(header->m_magic, c_magic, sizeof(c_magic)) != 0
+     || header->m_version != c_version
+     || entriesEnd > m_mapSize
+     || (m_mapSize - entriesEnd) % sizeof(State) != 0)
+    {
+        printf("TrajectoryCache: ignoring %s, not a version %u cache file\n", m_path.c_str(), c_version);
+        Unmap();
+        return;
+    }
+
+    m_entries = reinterpret_cast<const Entry*>(m_map + sizeof(Header));
+    m_states = reinterpret_cast<const State*>(m_map + entriesEnd);
+    m_numEntries = header->m_numTrajectories;
+    m_numStates = (m_mapSize - entriesEnd) / sizeof(State);
+}
+
+TrajectoryCache::~TrajectoryCache()
+{
+    Unmap();
+}
+
+frc::Trajectory TrajectoryCache::Get(const frc::Pose2d& start, const std::vector<frc::Translation2d>& interiorWaypoints, const frc::Pose2d& end, const frc::TrajectoryConfig& config)
+{
+    TRACE_SCOPE("TrajectoryCache::Get");
+
+    uint64_t key = Key(start, interiorWaypoints, end, config);
+    if (const Entry* entry = Find(key))
+    {
+        std::vector<frc::Trajectory::State> states;
+        states.reserve(entry->m_numStates);
+        for (const State* s = m_states + entry->m_firstState; s != m_states + entry->m_firstState + entry->m_numStates; s++)
+        {
+            states.push_back({ units::second_t(s->m_t)
+                             , units::meters_per_second_t(s->m_velocity)
+                             , units::meters_per_second_squared_t(s->m_acceleration)
+                             , frc::Pose2d(units::meter_t(s->m_x), units::meter_t(s->m_y), frc::Rotation2d(units::radian_t(s->m_rotation)))
+                             , decltype(frc::Trajectory::State::curvature)(s->m_curvature) });
+        }
+        m_hits++;
+        m_used.emplace_back(key, frc::Trajectory(states));
+    }
+    else
+    {
+        m_misses++;
+        m_used.emplace_back(key, frc::TrajectoryGenerator::GenerateTrajectory(start, interiorWaypoints, end, config));
+    }
+
+    return m_used.back().second;
+}
+
+bool TrajectoryCache::Save()
+{
+    if (m_misses == 0)
+    {
+        return true;
+    }
+
+    Header header;
+    memcpy(header.m_magic, c_magic, sizeof(c_magic));
+    header.m_version = c_version;
+    header.m_numTrajectories = m_used.size();
+    header.m_reserved = 0;
+
+    std::vector<Entry> entries;
+    std::vector<State> states;
+    for (const auto& used : m_used)
+    {
+        const auto& trajectoryStates = used.second.States();
+        entries.push_back({ used.first, static_cast<uint32_t>(states.size()), static_cast<uint32_t>(trajectoryStates.size()) });
+        for (const auto& s : trajectoryStates)
+        {
+            states.push_back({ s.t.to<double>()
+                             , s.velocity.to<double>()
+                             , s.acceleration.to<double>()
+                             , s.pose.Translation().X().to<double>()
+                             , s.pose.Translation().Y().to<double>()
+                             , s.pose.Rotation().Radians().to<double>()
+                             , s.curvature.to<double>() });
+        }
+    }
+
+    // Written beside the old file and renamed over it, so a reader never sees half a file
+    std::string tempPath = m_path + ".tmp";
+    int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        printf("TrajectoryCache: cannot open %s: %s\n", tempPath.c_str(), strerror(errno));
+        return false;
+    }
+
+    bool bOk = WriteAll(fd, &header, sizeof(header))
+            && WriteAll(fd, entries.data(), entries.size() * sizeof(Entry))
+            && WriteAll(fd, states.data(), states.size() * sizeof(State))
+            && fsync(fd) == 0;
+    close(fd);
+
+    if (!bOk || rename(tempPath.c_str(), m_path.c_str()) != 0)
+    {
+        printf("TrajectoryCache: cannot write %s: %s\n", m_path.c_str(), strerror(errno));
+        unlink(tempPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+uint64_t TrajectoryCache::Key(const frc::Pose2d& start, const std::vector<frc::Translation2d>& interiorWaypoints, const frc::Pose2d& end, const frc::TrajectoryConfig& config)
+{
+    KeyHash hash;
+    hash.Add(static_cast<double>(c_version));
+    hash.Add(start);
+    hash.Add(static_cast<double>(interiorWaypoints.size()));
+    for (const auto& waypoint : interiorWaypoints)
+    {
+        hash.Add(waypoint.X().to<double>());
+        hash.Add(waypoint.Y().to<double>());
+    }
+    hash.Add(end);
+
+    hash.Add(config.MaxVelocity().to<double>());
+    hash.Add(config.MaxAcceleration().to<double>());
+    hash.Add(config.StartVelocity().to<double>());
+    hash.Add(config.EndVelocity().to<double>());
+    hash.Add(config.IsReversed() ? 1.0 : 0.0);
+
+    // The kinematics constraint cannot be read back from the config, its module positions can be hashed from here
+    for (const auto& module : DriveConstants::kModuleConfigs)
+    {
+        hash.Add(module.m_x);
+        hash.Add(module.m_y);
+    }
+
+    return hash.Get();
+}
+
+const Entry* TrajectoryCache::Find(uint64_t key) const
+{
+    for (uint32_t i = 0; i < m_numEntries; i++)
+    {
+        const Entry& entry = m_entries[i];
+        if (entry.m_key != key)
+        {
+            continue;
+        }
+
+        if (!IsValid(entry))
+        {
+            printf("TrajectoryCache: damaged trajectory %016llx in %s, regenerating it\n", static_cast<unsigned long long>(key), m_path.c_str());
+            return nullptr;
+        }
+
+        return &entry;
+    }
+
+    return nullptr;
+}
+
+bool TrajectoryCache::IsValid(const Entry& entry) const
+{
+    if (entry.m_numStates == 0 || entry.m_firstState > m_numStates || entry.m_numStates > m_numStates - entry.m_firstState)
+    {
+        return false;
+    }
+
+    // Trajectory::Sample binary searches on t, which has to be finite and increasing
+    double last = -std::numeric_limits<double>::infinity();
+    for (const State* s = m_states + entry.m_firstState; s != m_states + entry.m_firstState + entry.m_numStates; s++)
+    {
+        if (!std::isfinite(s->m_t) || s->m_t <= last)
+        {
+            return false;
+        }
+        last = s->m_t;
+    }
+
+    return true;
+}
+
+void TrajectoryCache::Unmap()
+{
+    if (m_map != nullptr)
+    {
+        munmap(const_cast<uint8_t*>(m_map), m_mapSize);
+        m_map = nullptr;
+        m_mapSize = 0;
+        m_entries = nullptr;
+        m_states = nullptr;
+        m_numEntries = 0;
+        m_numStates = 0;
+    }
+}
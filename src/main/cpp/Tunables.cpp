@@ -0,0 +1,62 @@
+/*
+    Tunables registry
+*/
+
+#include "Tunables.h"
+
+#include <networktables/NetworkTable.h>
+#include <networktables/NetworkTableInstance.h>
+
+Tunables& Tunables::GetInstance()
+{
+    static Tunables instance;
+    return instance;
+}
+
+Tunable& Tunables::Add(const std::string& key, double initial)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_byKey.find(key);
+    if (it != m_byKey.end())
+    {
+        return *it->second;
+    }
+
+    auto tunable = std::make_unique<Tunable>();
+    tunable->m_entry = nt::NetworkTableInstance::GetDefault().GetTable("SmartDashboard")->GetEntry(key);
+    Tunable& added = Listen(std::move(tunable), initial);
+    m_byKey[key] = &added;
+
+    return added;
+}
+
+Tunable& Tunables::Add(nt::NetworkTableEntry entry, double initial)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto tunable = std::make_unique<Tunable>();
+    tunable->m_entry = entry;
+
+    return Listen(std::move(tunable), initial);
+}
+
+Tunable& Tunables::Listen(std::unique_ptr<Tunable> tunable, double initial)
+{
+    Tunable* t = tunable.get();
+    t->m_value.store(initial, std::memory_order_relaxed);
+    t->m_entry.SetDouble(initial);
+
+    // Runs on the NetworkTables notifier thread
+    t->m_entry.AddListener([this, t](const nt::EntryNotification& event)
+        {
+            if (event.value && event.value->IsDouble())
+            {
+                t->m_value.store(event.value->GetDouble(), std::memory_order_relaxed);
+                m_generation.fetch_add(1, std::memory_order_release);
+            }
+        }
+        , NT_NOTIFY_NEW | NT_NOTIFY_UPDATE);
+
+    m_tunables.push_back(std::move(tunable));
+
+    return *t;
+}
@@ -0,0 +1,151 @@
+/*
+    Physics of the simulated drivetrain
+*/
+
+// Desktop builds only, see hardware/Hardware.h
+#ifndef __FRC_ROBORIO__
+
+#include "hardware/DrivetrainSim.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace SimConstants;
+
+namespace
+{
+    constexpr double c_gravity = 9.81;
+    constexpr double c_radPerSecPerRpm = AngleMath::c_2pi / 60.0;
+    constexpr double c_wheelRadius = ModuleConstants::kWheelDiameterMeters / 2.0;
+
+    // Robot mass plus the drive rotors' inertia seen through the drive reduction
+    constexpr double c_driveReduction = DriveConstants::kDriveGearRatio / c_wheelRadius;   // Rotor rad per meter
+    constexpr double c_effectiveMass = kRobotMassKg + DriveConstants::kNumSwerveModules * kNeoRotorInertia * c_driveReduction * c_driveReduction;
+
+    constexpr double c_normalForce = kRobotMassKg * c_gravity / DriveConstants::kNumSwerveModules;
+    constexpr double c_tractionLimit = kWheelFrictionCoeff * c_normalForce;
+    constexpr double c_rollingResistance = kRollingResistanceCoeff * c_normalForce;
+
+    // Share of a contact patch's side slip the tread takes out in one step. Below 1 because
+    // all modules push on the same chassis at once.
+    constexpr double c_sideSlipRelaxation = 0.5;
+
+    // Below this the wheels count as stopped for static friction, rad/s and m/s
+    constexpr double c_steerStopped = 1.0e-3;
+    constexpr double c_driveStopped = 1.0e-3;
+
+    /// Applies a Coulomb friction force or torque of magnitude friction to the drive input
+    /// of something moving at rate, sticking when at rest and the drive cannot overcome it
+    double WithFriction(double drive, double rate, double stoppedRate, double friction)
+    {
+        if (fabs(rate) < stoppedRate)
+        {
+            return fabs(drive) <= friction ? 0.0 : drive - copysign(friction, drive);
+        }
+
+        return drive - copysign(friction, rate);
+    }
+}
+
+DrivetrainSim::DrivetrainSim(const Modules& modules, const Locations& locations, SimGyro& gyro)
+    : m_modules(modules)
+    , m_locations(locations)
+    , m_gyro(gyro)
+{
+}
+
+double DrivetrainSim::Step()
+{
+    double dt = kLoopPeriod / kStepsPerLoop;
+    for (int i = 0; i < kStepsPerLoop; i++)
+    {
+        StepPhysics(dt);
+    }
+    m_time += kLoopPeriod;
+    m_gyro.SetHeading(m_state.m_heading * 180.0 / AngleMath::c_pi, m_state.m_omega * 180.0 / AngleMath::c_pi);
+
+    return m_time;
+}
+
+void DrivetrainSim::SetState(const State& state)
+{
+    m_state = state;
+    m_gyro.SetHeading(m_state.m_heading * 180.0 / AngleMath::c_pi, m_state.m_omega * 180.0 / AngleMath::c_pi);
+}
+
+void DrivetrainSim::StepSteering(SimModuleHardware& module, double dt)
+{
+    constexpr double G = DriveConstants::kTurnMotorRevsPerWheelRev;
+    constexpr double inertia = kSteerInertia + kNeoRotorInertia * G * G;
+
+    SimMotor& motor = module.m_turnMotor;
+    double rate = motor.GetRotorRpm() * c_radPerSecPerRpm / G;      // Wheel steering rate, rad/s
+    double torque = motor.Step() * G - kSteerViscousFriction * rate;
+    torque = WithFriction(torque, rate, c_steerStopped, kSteerFrictionTorque);
+
+    double newRate = rate + torque / inertia * dt;
+    if (rate * newRate < 0.0)
+    {
+        // Friction stops the wheel, it does not reverse it
+        newRate = 0.0;
+    }
+
+    double rotorRpm = newRate * G / c_radPerSecPerRpm;
+    motor.SetRotor(motor.GetRotorRevs() + rotorRpm / 60.0 * dt, rotorRpm);
+}
+
+void DrivetrainSim::StepPhysics(double dt)
+{
+    double cosHeading = cos(m_state.m_heading);
+    double sinHeading = sin(m_state.m_heading);
+
+    double forceX = 0.0;
+    double forceY = 0.0;
+    double torque = 0.0;
+    for (size_t i = 0; i < m_modules.size(); i++)
+    {
+        SimModuleHardware& module = *m_modules[i];
+        StepSteering(module, dt);
+
+        // Module position relative to the robot center and wheel direction, field frame
+        double rx = cosHeading * m_locations[i].m_x - sinHeading * m_locations[i].m_y;
+        double ry = sinHeading * m_locations[i].m_x + cosHeading * m_locations[i].m_y;
+        double wheelAngle = m_state.m_heading + module.m_absEncoder.GetWheelAngle();
+        double ux = cos(wheelAngle);
+        double uy = sin(wheelAngle);
+
+        // Contact patch velocity along and across the wheel
+        double vx = m_state.m_vx - m_state.m_omega * ry;
+        double vy = m_state.m_vy + m_state.m_omega * rx;
+        double vAlong = vx * ux + vy * uy;
+        double vAcross = -vx * uy + vy * ux;
+
+        // The wheel rolls without slipping, so the drive rotor turns with the ground
+        SimMotor& motor = module.m_driveMotor;
+        double rotorRpm = vAlong * c_driveReduction / c_radPerSecPerRpm;
+        motor.SetRotor(motor.GetRotorRevs() + rotorRpm / 60.0 * dt, rotorRpm);
+
+        double fAlong = motor.Step() * c_driveReduction;
+        fAlong = WithFriction(fAlong, vAlong, c_driveStopped, c_rollingResistance);
+        fAlong = std::clamp(fAlong, -c_tractionLimit, c_tractionLimit);
+
+        double fAcross = -c_sideSlipRelaxation * c_effectiveMass / DriveConstants::kNumSwerveModules * vAcross / dt;
+        fAcross = std::clamp(fAcross, -c_tractionLimit, c_tractionLimit);
+
+        double fx = fAlong * ux - fAcross * uy;
+        double fy = fAlong * uy + fAcross * ux;
+        forceX += fx;
+        forceY += fy;
+        torque += rx * fy - ry * fx;
+    }
+
+    m_state.m_vx += forceX / c_effectiveMass * dt;
+    m_state.m_vy += forceY / c_effectiveMass * dt;
+    m_state.m_omega += torque / kRobotMomentOfInertia * dt;
+
+    m_state.m_x += m_state.m_vx * dt;
+    m_state.m_y += m_state.m_vy * dt;
+    m_state.m_heading += m_state.m_omega * dt;
+}
+
+#endif
@@ -0,0 +1,80 @@
+/*
+    Simulated drivetrain hardware
+*/
+
+// Desktop builds only, see hardware/Hardware.h
+#ifndef __FRC_ROBORIO__
+
+#include "hardware/SimHardware.h"
+
+#include <algorithm>
+
+using namespace SimConstants;
+
+namespace
+{
+    // NEO electrical model from its data sheet numbers
+    constexpr double c_resistance = kBatteryVolts / kNeoStallCurrent;                                  // Ohm
+    constexpr double c_rpmPerVolt = kNeoFreeSpeedRpm / (kBatteryVolts - kNeoFreeCurrent * c_resistance);
+    constexpr double c_torquePerAmp = kNeoStallTorque / kNeoStallCurrent;
+}
+
+double SimMotor::Step()
+{
+    // One pass of the onboard loop, which runs once per physics step like the Spark MAX's 1 kHz loop
+    double output = m_reference;
+    if (m_mode != EMotorControl::eDutyCycle)
+    {
+        double measured = m_mode == EMotorControl::ePosition ? GetEncoderPosition() : GetEncoderVelocity();
+        double error = m_reference - measured;
+        if (m_iZone != 0.0 && fabs(error) > m_iZone)
+        {
+            m_iAccum = 0.0;
+        }
+        else
+        {
+            m_iAccum += error;
+        }
+        output = m_p * error + m_i * m_iAccum + m_d * (error - m_prevError) + m_ff * m_reference;
+        m_prevError = error;
+    }
+    output = std::clamp(output, m_minOutput, m_maxOutput);
+
+    // The smart current limit cuts the applied voltage until the current is back at the limit
+    double backEmf = m_rotorRpm / c_rpmPerVolt;
+    double current = (output * kBatteryVolts - backEmf) / c_resistance;
+    if (fabs(current) > m_currentLimit)
+    {
+        current = copysign(m_currentLimit, current);
+        output = (current * c_resistance + backEmf) / kBatteryVolts;
+    }
+
+    m_appliedOutput = output;
+    m_current = current;
+
+    return current * c_torquePerAmp;
+}
+
+double SimAbsoluteEncoder::GetVoltageImpl()
+{
+    // Inverse of AngleMath::VoltageToRadians plus noise, wrapping at the top of the range like the sensor does
+    double fullScale = AngleMath::c_2pi / DriveConstants::kTurnVoltageToRadians;
+    double volts = AngleMath::ZeroTo2Pi(m_offset - GetWheelAngle()) / DriveConstants::kTurnVoltageToRadians;
+
+    return AngleMath::ZeroToPeriod(volts + m_noise(m_rng), fullScale);
+}
+
+double SimAbsoluteEncoder::GetAverageVoltageImpl()
+{
+    // Plain mean of noisy samples, wrong across the wrap just like the FPGA's. The wheel is
+    // taken as still for the length of the window.
+    double sum = 0.0;
+    for (int i = 0; i < m_samplesPerAverage; i++)
+    {
+        sum += GetVoltageImpl();
+    }
+
+    return sum / m_samplesPerAverage;
+}
+
+#endif
@@ -11,72 +11,43 @@
 #include <units/units.h>
 
 #include "Constants.h"
+#include "Trace.h"
 #include <iostream>
-#include <frc/SmartDashBoard/SmartDashboard.h>
+#include <frc/smartdashboard/SmartDashboard.h>
 #include <frc/shuffleboard/Shuffleboard.h>
 
 using namespace DriveConstants;
 using namespace std;
 using namespace frc;
 
-DriveSubsystem::DriveSubsystem(Logger& log)
+template <typename Hw>
+DriveSubsystemT<Hw>::DriveSubsystemT(Logger& log)
     : m_log(log)
-    , m_logData(c_headerNamesDriveSubsystem, true, "")
-    , m_frontLeft
-      {
-          kFrontLeftDriveMotorPort
-        , kFrontLeftTurningMotorPort
-        , kFrontLeftDriveEncoderPort
-        , kFrontLeftTurningEncoderPort
-        , kFrontLeftDriveMotorReversed
-        , kFrontLeftTurningEncoderReversed
-        , kFrontLeftOffset
-        , std::string("FrontLeft")
-        , log
-      }
-
-    , m_frontRight
-      {
-          kFrontRightDriveMotorPort
-        , kFrontRightTurningMotorPort
-        , kFrontRightDriveEncoderPort
-        , kFrontRightTurningEncoderPort
-        , kFrontRightDriveMotorReversed
-        , kFrontRightTurningEncoderReversed
-        , kFrontRightOffset
-        , std::string("FrontRight")
-        , log
-      }
-
-    , m_rearRight
-      {
-          kRearRightDriveMotorPort
-        , kRearRightTurningMotorPort
-        , kRearRightDriveEncoderPort
-        , kRearRightTurningEncoderPort
-        , kRearRightDriveMotorReversed
-        , kRearRightTurningEncoderReversed
-        , kRearRightOffset
-        , std::string("RearRight")
-        , log
-      }
-
-    , m_rearLeft
-      {
-          kRearLeftDriveMotorPort
-        , kRearLeftTurningMotorPort
-        , kRearLeftDriveEncoderPort
-        , kRearLeftTurningEncoderPort
-        , kRearLeftDriveMotorReversed
-        , kRearLeftTurningEncoderReversed
-        , kRearLeftOffset
-        , std::string("RearLeft")
-        , log
-      }
-
+    , m_logData(true, "", LogConstants::kLoopsPerSecond)
+    , m_modules(MakeModules(log))
     , m_gyro(0)
+    , m_world(GetModuleHardware(), GetModuleLocations(), m_gyro)
+    , m_gyroService(m_gyro, kGyroReversed
+                  , c_bOdometryThread<Hw> ? CanConstants::kOdometryStatusPeriodMs : CanConstants::kPigeonStatusPeriodMs
+                  , CanConstants::kPigeonUnusedStatusPeriodMs, m_world.GetTime())
     , m_odometry{kDriveKinematics, GetHeadingAsRot2d(), frc::Pose2d()}
+    , m_pose(PublishedPose{0.0, 0.0, 0.0})
 {
+    if (CanConstants::kActuatorThread && Hw::World::c_bRealTime)
+    {
+        for (auto& module : m_modules)
+        {
+            module.AddActuators(m_actuatorWorker);
+        }
+        m_actuatorWorker.Start();
+    }
+
+    if (c_bOdometryThread<Hw>)
+    {
+        m_odometryNotifier = std::make_unique<frc::Notifier>([this] { OdometryThreadStep(); });
+        m_odometryNotifier->StartPeriodic(second_t(1.0 / kOdometryHz));
+    }
+
     SmartDashboard::PutBoolean("GetInputFromNetTable", true);
 
     SmartDashboard::PutNumber("FrontLeft", 0.0);
@@ -98,25 +69,67 @@ DriveSubsystem::DriveSubsystem(Logger& log)
     SmartDashboard::PutNumber("Tolerance", 0.1);
 }
 
-void DriveSubsystem::Periodic()
+template <typename Hw>
+void DriveSubsystemT<Hw>::Periodic()
 {
-    // Implementation of subsystem periodic method goes here.
-    m_odometry.Update(GetHeadingAsRot2d()
-                    , m_frontLeft.GetState()
-                    , m_rearLeft.GetState() // TODO check order FL, RL?
-                    , m_frontRight.GetState()
-                    , m_rearRight.GetState());
+    TRACE_SCOPE("DriveSubsystem::Periodic");
+
+    // Subsystems run before commands, so odometry here and Drive/SetModuleStates later in the loop see the same sample.
+    // A simulated world advances one loop here with the setpoints sent last loop, in lockstep with the robot code.
+    double timestamp = m_world.Step();
+    for (size_t i = 0; i < m_modules.size(); i++)
+    {
+        m_modules[i].Sample(timestamp);
+        m_moduleStates[i] = m_modules[i].GetState();
+    }
+
+    // Module states go to the odometry in kinematics order
+    if (!c_bOdometryThread<Hw>)
+    {
+        m_gyroService.Update(timestamp);
+        UpdateOdometry(timestamp, m_moduleStates, std::make_index_sequence<kNumSwerveModules>());
+    }
    
-    auto pose = m_odometry.GetPose();
+    frc::Pose2d pose = GetPose();
      
     m_logData[EDriveSubSystemLogData::eOdoX] = pose.Translation().X().to<double>();
     m_logData[EDriveSubSystemLogData::eOdoY] = pose.Translation().Y().to<double>();
     m_logData[EDriveSubSystemLogData::eOdoRot] = pose.Rotation().Degrees().to<double>();
-    m_log.logData<EDriveSubSystemLogData>("DriveSubsystem::Periodic", __LINE__, m_logData);
+    m_logData[EDriveSubSystemLogData::eTurnRate] = GetTurnRate();
+    if (m_logSiteId < 0)
+    {
+        m_logSiteId = m_log.RegisterSite("DriveSubsystem::Periodic", __LINE__);
+    }
+    m_log.logData<EDriveSubSystemLogData>(m_logSiteId, m_logData);
 }
 
-void DriveSubsystem::Drive(meters_per_second_t xSpeed, meters_per_second_t ySpeed, radians_per_second_t rot, bool fieldRelative)
+template <typename Hw>
+void DriveSubsystemT<Hw>::OdometryThreadStep()
 {
+    TRACE_SCOPE("DriveSubsystem::OdometryThreadStep");
+
+    double timestamp = m_world.GetTime();
+    m_gyroService.Update(timestamp);
+
+    SwerveModuleStates states;
+    for (size_t i = 0; i < m_modules.size(); i++)
+    {
+        states[i] = m_modules[i].ReadState();
+    }
+
+    UpdateOdometry(timestamp, states, std::make_index_sequence<kNumSwerveModules>());
+}
+
+template <typename Hw>
+void DriveSubsystemT<Hw>::PublishPose(const frc::Pose2d& pose)
+{
+    m_pose.Write({ pose.Translation().X().to<double>(), pose.Translation().Y().to<double>(), pose.Rotation().Radians().to<double>() });
+}
+
+template <typename Hw>
+void DriveSubsystemT<Hw>::Drive(meters_per_second_t xSpeed, meters_per_second_t ySpeed, radians_per_second_t rot, bool fieldRelative)
+{
+    TRACE_SCOPE("DriveSubsystem::Drive");
     m_logData[EDriveSubSystemLogData::eInputX] = xSpeed.to<double>();
     m_logData[EDriveSubSystemLogData::eInputY] = ySpeed.to<double>();
     m_logData[EDriveSubSystemLogData::eInputRot] = rot.to<double>();
@@ -135,9 +148,8 @@ void DriveSubsystem::Drive(meters_per_second_t xSpeed, meters_per_second_t ySpee
     else
         chassisSpeeds = frc::ChassisSpeeds{xSpeed, ySpeed, rot};
 
-    auto states = kDriveKinematics.ToSwerveModuleStates(chassisSpeeds);
-
-    kDriveKinematics.NormalizeWheelSpeeds(&states, AutoConstants::kMaxSpeed);
+    SwerveModuleStates states;
+    c_kinematics.ToSwerveModuleStates(chassisSpeeds, AutoConstants::kMaxSpeed.to<double>(), states);
     
     //if (SmartDashboard::GetBoolean("GetInputFromNetTable", false))
     if (false)
@@ -167,57 +179,150 @@ void DriveSubsystem::Drive(meters_per_second_t xSpeed, meters_per_second_t ySpee
         states[eFrontLeft].speed = meters_per_second_t(speed);
     }
 
-    m_frontLeft.SetDesiredState(states[eFrontLeft]);
-    m_frontRight.SetDesiredState(states[eFrontRight]);
-    m_rearRight.SetDesiredState(states[eRearRight]);
-    m_rearLeft.SetDesiredState(states[eRearLeft]);
+    ApplyModuleStates(states);
+}
+
+template <typename Hw>
+void DriveSubsystemT<Hw>::SetModuleStates(SwerveModuleStates desiredStates)
+{
+    c_kinematics.Desaturate(desiredStates, AutoConstants::kMaxSpeed.to<double>());
+    ApplyModuleStates(desiredStates);
+}
+
+template <typename Hw>
+void DriveSubsystemT<Hw>::ApplyModuleStates(const SwerveModuleStates& desiredStates)
+{
+    ModuleArrays& arrays = m_moduleArrays;
+    for (size_t i = 0; i < m_modules.size(); i++)
+    {
+        arrays.m_turnPosition[i] = m_modules[i].PrepareTurn(desiredStates[i].speed.to<double>());
+        arrays.m_desiredAngle[i] = desiredStates[i].angle.Radians().to<double>();
+    }
+
+    AngleMath::MinTurnRads(arrays.m_turnPosition, arrays.m_desiredAngle, arrays.m_minTurnRads, arrays.m_bOutputReverse);
+
+    for (size_t i = 0; i < m_modules.size(); i++)
+    {
+        m_modules[i].SetDesiredState(desiredStates[i], arrays.m_minTurnRads[i], arrays.m_bOutputReverse[i]);
+    }
+
+    // Whatever the modules posted goes out on the actuator thread, if there is one
+    m_actuatorWorker.Wake();
 }
 
-void DriveSubsystem::SetModuleStates(SwerveModuleStates desiredStates)
+template <typename Hw>
+void DriveSubsystemT<Hw>::ResetEncoders()
 {
-    kDriveKinematics.NormalizeWheelSpeeds(&desiredStates, AutoConstants::kMaxSpeed);
-    m_frontLeft.SetDesiredState(desiredStates[eFrontLeft]);
-    m_frontRight.SetDesiredState(desiredStates[eFrontRight]);
-    m_rearRight.SetDesiredState(desiredStates[eRearRight]);
-    m_rearLeft.SetDesiredState(desiredStates[eRearLeft]);
+    for (auto& module : m_modules)
+    {
+        module.ResetEncoders();
+    }
 }
 
-void DriveSubsystem::ResetEncoders()
+template <typename Hw>
+typename DriveSubsystemT<Hw>::template PerModule<typename Hw::Module*> DriveSubsystemT<Hw>::GetModuleHardware()
 {
-    m_frontLeft.ResetEncoders();
-    m_frontRight.ResetEncoders();
-    m_rearRight.ResetEncoders();
-    m_rearLeft.ResetEncoders();
+    return GetModuleHardware(m_modules);
 }
 
-double DriveSubsystem::GetHeading()
+template <typename Hw>
+typename DriveSubsystemT<Hw>::template PerModule<typename Hw::Module*> DriveSubsystemT<Hw>::GetModuleHardware(Modules& modules)
 {
-    auto retVal = std::remainder(m_gyro.GetFusedHeading(), 360.0) * (kGyroReversed ? -1. : 1.);
-    if (retVal > 180.0)
+    PerModule<typename Hw::Module*> hardware;
+    for (size_t i = 0; i < modules.size(); i++)
     {
-        retVal -= 360.0;
+        hardware[i] = &modules[i].GetHardware();
     }
 
-    return retVal;
+    return hardware;
 }
 
-void DriveSubsystem::ZeroHeading()
+template <typename Hw>
+typename DriveSubsystemT<Hw>::template PerModule<ModuleLocation> DriveSubsystemT<Hw>::GetModuleLocations()
 {
-    m_gyro.ClearStickyFaults();
-    //m_gyro.SetFusedHeading(0.0, 0);
+    PerModule<ModuleLocation> locations;
+    for (size_t i = 0; i < kModuleConfigs.size(); i++)
+    {
+        locations[i] = { kModuleConfigs[i].m_x, kModuleConfigs[i].m_y };
+    }
+
+    return locations;
+}
+
+template <typename Hw>
+double DriveSubsystemT<Hw>::GetHeading()
+{
+    return m_gyroService.GetHeading();
 }
 
-double DriveSubsystem::GetTurnRate()
+template <typename Hw>
+void DriveSubsystemT<Hw>::ZeroHeading()
 {
-    return 0.0; //m_gyro.GetRate() * (kGyroReversed ? -1. : 1.);
+    m_gyroService.Zero();
 }
 
-frc::Pose2d DriveSubsystem::GetPose()
+template <typename Hw>
+double DriveSubsystemT<Hw>::GetTurnRate()
 {
-    return m_odometry.GetPose();
+    return m_gyroService.GetTurnRate();
 }
 
-void DriveSubsystem::ResetOdometry(frc::Pose2d pose)
+template <typename Hw>
+frc::Pose2d DriveSubsystemT<Hw>::GetPose()
 {
-    m_odometry.ResetPosition(pose, GetHeadingAsRot2d());
+    PublishedPose pose = m_pose.Read();
+    return frc::Pose2d(meter_t(pose.m_x), meter_t(pose.m_y), frc::Rotation2d(radian_t(pose.m_rotation)));
 }
+
+template <typename Hw>
+void DriveSubsystemT<Hw>::ResetOdometry(frc::Pose2d pose)
+{
+    frc::Rotation2d heading = GetHeadingAsRot2d();
+    std::lock_guard<std::mutex> lock(m_odometryMutex);
+    m_odometry.ResetPosition(pose, heading);
+    PublishPose(pose);
+    m_poseHistory.Clear();
+}
+
+template <typename Hw>
+bool DriveSubsystemT<Hw>::GetPoseAt(double timestamp, frc::Pose2d& pose)
+{
+    typename decltype(m_poseHistory)::Record record;
+    {
+        std::lock_guard<std::mutex> lock(m_odometryMutex);
+        if (!m_poseHistory.Sample(timestamp, record))
+        {
+            return false;
+        }
+    }
+
+    pose = frc::Pose2d(meter_t(record.m_x), meter_t(record.m_y), frc::Rotation2d(radian_t(record.m_rotation)));
+    return true;
+}
+
+template <typename Hw>
+bool DriveSubsystemT<Hw>::AddPoseMeasurement(const frc::Pose2d& pose, double timestamp)
+{
+    TRACE_SCOPE("DriveSubsystem::AddPoseMeasurement");
+
+    std::lock_guard<std::mutex> lock(m_odometryMutex);
+    if (!m_poseHistory.Rebase(timestamp, pose.Translation().X().to<double>(), pose.Translation().Y().to<double>(), pose.Rotation().Radians().to<double>()))
+    {
+        return false;
+    }
+
+    // Carry on from the corrected newest pose, with the gyro reading its update used so the
+    // next update's heading change is measured from the same place
+    const auto& newest = m_poseHistory.Newest();
+    frc::Pose2d corrected(meter_t(newest.m_x), meter_t(newest.m_y), frc::Rotation2d(radian_t(newest.m_rotation)));
+    m_odometry.ResetPosition(corrected, frc::Rotation2d(radian_t(newest.m_heading)));
+    PublishPose(corrected);
+
+    return true;
+}
+
+#ifdef __FRC_ROBORIO__
+template class DriveSubsystemT<RobotHardware>;
+#else
+template class DriveSubsystemT<SimHardware>;
+#endif
@@ -14,41 +14,59 @@
 #include <iostream>
 
 #include "Constants.h"
+#include "Trace.h"
 
-SwerveModule::SwerveModule(int driveMotorChannel, 
-                           int turningMotorChannel,
-                           const int driveEncoderPort,
-                           const int turningEncoderPort,
-                           bool driveMotorReversed,
-                           bool turningEncoderReversed,
-                           double offset,
-                           const std::string& name,
-                           Logger& log)
-    : m_driveMotor(driveMotorChannel, CANSparkMax::MotorType::kBrushless)
-    , m_turningMotor(turningMotorChannel, CANSparkMax::MotorType::kBrushless)
-    , m_driveEncoder(m_driveMotor)
-    , m_turnNeoEncoder(m_turningMotor)
-    , m_turningEncoder(turningEncoderPort)
-    , m_offset(offset)
-    , m_name(name)
-    , m_logData(c_headerNamesSwerveModule, true, name)
+namespace
+{
+    SparkMaxTrafficConfig MakeTrafficConfig(double tolerance, int status1PeriodMs, int status2PeriodMs)
+    {
+        SparkMaxTrafficConfig config;
+        config.m_tolerance = tolerance;
+        config.m_keepAlive = CanConstants::kSetpointKeepAlive;
+        config.m_status0PeriodMs = CanConstants::kStatus0PeriodMs;
+        config.m_status1PeriodMs = status1PeriodMs;
+        config.m_status2PeriodMs = status2PeriodMs;
+        return config;
+    }
+}
+
+template <typename Hw>
+SwerveModuleT<Hw>::SwerveModuleT(const DriveConstants::SwerveModuleConfig& config, Logger& log)
+    : m_offset(config.m_offset)
+    , m_name(config.m_name)
+    , m_hw(config.m_driveMotorPort, config.m_turningMotorPort, config.m_turningEncoderPort, config.m_offset)
+    // The odometry thread reads drive velocity (status 1) and turn position (status 2) at its own rate
+    , m_driveTraffic(m_hw.m_driveMotor, m_hw.m_driveEncoder, MakeTrafficConfig(CanConstants::kDriveSetpointTolerance
+                                                         , c_bOdometryThread<Hw> ? CanConstants::kOdometryStatusPeriodMs : CanConstants::kStatus1PeriodMs
+                                                         , CanConstants::kDriveStatus2PeriodMs))
+    , m_turnTraffic(m_hw.m_turnMotor, m_hw.m_turnEncoder, MakeTrafficConfig(CanConstants::kTurnSetpointTolerance
+                                                       , CanConstants::kStatus1PeriodMs
+                                                       , c_bOdometryThread<Hw> ? CanConstants::kOdometryStatusPeriodMs : CanConstants::kTurnStatus2PeriodMs))
+    , m_absAngleFilter(ModuleConstants::kAbsEncoderFilterAlpha, ModuleConstants::kAbsEncoderFilterBeta, ModuleConstants::kAbsEncoderWrapMargin)
+    , m_logData(true, m_name, LogConstants::kLoopsPerSecond)
+    , m_logStats(LogConstants::kStatsWindowSeconds)
     , m_log(log)
+    , m_currentFaultReason(m_name + " current spike")
+    , m_turnFaultReason(m_name + " turn error")
 {
-    m_driveMotor.SetSmartCurrentLimit(ModuleConstants::kMotorCurrentLimit);
-    m_turningMotor.SetSmartCurrentLimit(ModuleConstants::kMotorCurrentLimit);
+    m_hw.m_driveMotor.SetSmartCurrentLimit(ModuleConstants::kMotorCurrentLimit);
+    m_hw.m_turnMotor.SetSmartCurrentLimit(ModuleConstants::kMotorCurrentLimit);
 
     // Set up GetVelocity() to return meters per sec instead of RPM
-    m_driveEncoder.SetVelocityConversionFactor(wpi::math::pi * ModuleConstants::kWheelDiameterMeters / (DriveConstants::kDriveGearRatio * 60.0));
-    m_turnNeoEncoder.SetPositionConversionFactor(2 * wpi::math::pi / DriveConstants::kTurnMotorRevsPerWheelRev);
+    m_hw.m_driveEncoder.SetVelocityConversionFactor(wpi::math::pi * ModuleConstants::kWheelDiameterMeters / (DriveConstants::kDriveGearRatio * 60.0));
+    m_hw.m_turnEncoder.SetPositionConversionFactor(2 * wpi::math::pi / DriveConstants::kTurnMotorRevsPerWheelRev);
     
-    m_driveMotor.SetInverted(driveMotorReversed);
-    m_turningMotor.SetInverted(false);
+    m_hw.m_driveMotor.SetInverted(config.m_driveMotorReversed);
+    m_hw.m_turnMotor.SetInverted(false);
 
-    m_drivePidParams.Load(m_drivePIDController);
-    m_turnPidParams.Load(m_turnPIDController);
+    m_drivePidParams.Load(m_hw.m_driveMotor);
+    m_turnPidParams.Load(m_hw.m_turnMotor);
 
-    double initPosition = VoltageToRadians(m_turningEncoder.GetVoltage(), m_offset);
-    m_turnNeoEncoder.SetPosition(initPosition); // Tell the encoder where the absolute encoder is
+    m_hw.m_absEncoder.SetAveraging(ModuleConstants::kAbsEncoderOversampleBits, ModuleConstants::kAbsEncoderAverageBits);
+    m_absAveragingWindow = m_hw.m_absEncoder.GetAveragingWindow();
+
+    double initPosition = VoltageToRadians(m_hw.m_absEncoder.GetVoltage());
+    m_hw.m_turnEncoder.SetPosition(initPosition); // Tell the encoder where the absolute encoder is
 
     ShuffleboardTab& tab = Shuffleboard::GetTab("AbsEncTuning");
     std::string nteName = m_name + " offset";
@@ -58,37 +76,93 @@ SwerveModule::SwerveModule(int driveMotorChannel,
         , std::make_pair("Max", nt::Value::MakeDouble(2 * wpi::math::pi))
         , std::make_pair("Block increment", nt::Value::MakeDouble(wpi::math::pi / 180))
     };
-    m_nteAbsEncTuningOffset    = tab.Add(nteName, m_offset)
+    auto nteAbsEncTuningOffset = tab.Add(nteName, m_offset)
                                     .WithWidget(frc::BuiltInWidgets::kNumberSlider)
                                     .WithProperties(sliderPropMap)
                                     .GetEntry();
+    m_tuneOffset = &Tunables::GetInstance().Add(nteAbsEncTuningOffset, m_offset);
 }
 
-frc::SwerveModuleState SwerveModule::GetState()
+template <typename Hw>
+void SwerveModuleT<Hw>::Sample(double timestamp)
 {
-    double angle = VoltageToRadians(m_turningEncoder.GetVoltage(), m_offset);
-    return {meters_per_second_t{m_driveEncoder.GetVelocity()}, frc::Rotation2d(radian_t(angle))};
+    TRACE_SCOPE("SwerveModule::Sample");
+
+    // Pick up dashboard tuning here, before anything is read or sent to the controllers this loop
+    if (Tunables::GetInstance().Changed(m_tunablesSeen))
+    {
+        TRACE_SCOPE("SwerveModule::ApplyTunables");
+        m_drivePidParams.Apply(m_hw.m_driveMotor);
+        m_turnPidParams.Apply(m_hw.m_turnMotor);
+        m_offset = m_tuneOffset->Get();
+    }
+
+    m_sample.m_timestamp = timestamp;
+
+    // The averaged reading is only good while the whole window is clear of where the voltage wraps
+    double latency = 0.0;
+    if (ModuleConstants::kAbsEncoderFiltered && m_absAngleFilter.IsAverageValid(timestamp, m_absAveragingWindow, VoltageToRadians(0.0)))
+    {
+        m_sample.m_turnEncVolts = TRACE_CALL("AnalogInput::GetAverageVoltage", m_hw.m_absEncoder.GetAverageVoltage());
+        latency = m_absAveragingWindow / 2.0;
+    }
+    else
+    {
+        m_sample.m_turnEncVolts = TRACE_CALL("AnalogInput::GetVoltage", m_hw.m_absEncoder.GetVoltage());
+    }
+    double measuredAngle = VoltageToRadians(m_sample.m_turnEncVolts);
+    m_absAngleFilter.Update(measuredAngle, timestamp, latency);
+    m_sample.m_turnEncAngle = ModuleConstants::kAbsEncoderFiltered ? m_absAngleFilter.GetAngle() : measuredAngle;
+    m_sample.m_turnEncRate = m_absAngleFilter.GetRate();
+    m_sample.m_turnEncNoise = m_absAngleFilter.GetNoise();
+    m_sample.m_turnEncLatency = latency;
+
+    m_sample.m_turnNeoPosition = TRACE_CALL("CANEncoder::GetPosition", m_hw.m_turnEncoder.GetPosition());
+    m_sample.m_driveVelocity = TRACE_CALL("CANEncoder::GetVelocity", m_hw.m_driveEncoder.GetVelocity());
+    m_neoToAbs.store(AngleMath::NegPiToPi(m_sample.m_turnEncAngle - m_sample.m_turnNeoPosition), std::memory_order_relaxed);
+    m_sample.m_turnOutputDutyCyc = TRACE_CALL("CANSparkMax::GetAppliedOutput", m_hw.m_turnMotor.GetAppliedOutput());
+    m_sample.m_driveOutputDutyCyc = TRACE_CALL("CANSparkMax::GetAppliedOutput", m_hw.m_driveMotor.GetAppliedOutput());
+    m_sample.m_turnOutputCurrent = TRACE_CALL("CANSparkMax::GetOutputCurrent", m_hw.m_turnMotor.GetOutputCurrent());
+    m_sample.m_driveOutputCurrent = TRACE_CALL("CANSparkMax::GetOutputCurrent", m_hw.m_driveMotor.GetOutputCurrent());
 }
 
-void SwerveModule::SetDesiredState(frc::SwerveModuleState &state)
+template <typename Hw>
+frc::SwerveModuleState SwerveModuleT<Hw>::GetState()
 {
-    // Retrieving turn PID values from SmartDashboard
-    m_drivePidParams.LoadFromNetworkTable(m_drivePIDController);
-    m_turnPidParams.LoadFromNetworkTable(m_turnPIDController);
-
-    // Find absolute encoder and NEO encoder positions
-    double absAngle = VoltageToRadians(m_turningEncoder.GetVoltage(), m_offset);
-    double currentPosition = m_turnNeoEncoder.GetPosition();
-
-    // Calculate new turn position given current Neo position, current absolute encoder position, and desired state position
-    bool bOutputReverse = false;
-#define USE_ABS_ENC
-#ifdef USE_ABS_ENC
-    double minTurnRads = MinTurnRads(absAngle, state.angle.Radians().to<double>(), bOutputReverse);
-#else
-    double minTurnRads = MinTurnRads(currentPosition, state.angle.Radians().to<double>(), bOutputReverse);
-#endif
-    SmartDashboard::PutNumber("bOutputReverse", bOutputReverse);
+    return {meters_per_second_t{m_sample.m_driveVelocity}, frc::Rotation2d(radian_t(m_sample.m_turnEncAngle))};
+}
+
+template <typename Hw>
+frc::SwerveModuleState SwerveModuleT<Hw>::ReadState()
+{
+    double velocity = TRACE_CALL("CANEncoder::GetVelocity", m_hw.m_driveEncoder.GetVelocity());
+    double angle = TRACE_CALL("CANEncoder::GetPosition", m_hw.m_turnEncoder.GetPosition()) + m_neoToAbs.load(std::memory_order_relaxed);
+
+    return {meters_per_second_t{velocity}, frc::Rotation2d(radian_t(angle))};
+}
+
+template <typename Hw>
+double SwerveModuleT<Hw>::PrepareTurn(double speed)
+{
+    m_frameError = AngleMath::NegPiToPi(m_sample.m_turnEncAngle - m_sample.m_turnNeoPosition);
+    if (!ModuleConstants::kTurnInNeoFrame)
+    {
+        return m_sample.m_turnEncAngle;
+    }
+
+    ResyncTurnEncoder(speed);
+    return m_sample.m_turnNeoPosition;
+}
+
+template <typename Hw>
+void SwerveModuleT<Hw>::SetDesiredState(const frc::SwerveModuleState& state, double minTurnRads, bool bOutputReverse)
+{
+    TRACE_SCOPE("SwerveModule::SetDesiredState");
+
+    // Absolute encoder and NEO encoder positions from this loop's sample, the NEO position in the frame PrepareTurn left it in
+    double absAngle = m_sample.m_turnEncAngle;
+    double currentPosition = m_sample.m_turnNeoPosition;
+
     double direction = 1.0;
     if (bOutputReverse)
         direction = -1.0;
@@ -97,120 +171,122 @@ void SwerveModule::SetDesiredState(frc::SwerveModuleState &state)
     // Set position reference of turnPIDController
     double newPosition = currentPosition + minTurnRads;
 
+    double now = m_sample.m_timestamp;
+
 //#define TUNE_ABS_ENC
 #ifdef TUNE_ABS_ENC
-    m_drivePIDController.SetReference(0.0, rev::ControlType::kVelocity);
-#endif
-
-    // If we're stopping then stop the drive motors and leave the angle alone
-    if (state.speed.to<double>() == 0.0)
+    m_driveTraffic.SetReference(0.0, EMotorControl::eVelocity, now);
+#else
+    // Stop the drive motor when asked to, otherwise let the turn complete before we activate it.
+    // One drive setpoint per loop at most.
+    if (state.speed.to<double>() == 0.0 || fabs(currentPosition - newPosition) < 0.35)
     {
-#ifndef TUNE_ABS_ENC
-        m_drivePIDController.SetReference(state.speed.to<double>(), rev::ControlType::kVelocity);
-#endif
+        m_driveTraffic.SetReference(direction * state.speed.to<double>(), EMotorControl::eVelocity, now);
     }
-    else
+#endif
+
+    // If we're stopping leave the angle alone
+    if (state.speed.to<double>() != 0.0)
     {
-        // Otherwise set the angle
-        m_turnPIDController.SetReference(newPosition, rev::ControlType::kPosition);
+        m_turnTraffic.SetReference(newPosition, EMotorControl::ePosition, now);
     }
-    
-    // Let the turn complete before we activate the motor
-    if (fabs(currentPosition - newPosition) < 0.35)
+
+    if (m_logSiteId < 0)
     {
-        // Set velocity reference of drivePIDController
-#ifndef TUNE_ABS_ENC
-        m_drivePIDController.SetReference(direction * state.speed.to<double>(), rev::ControlType::kVelocity);
-#endif
+        m_logSiteId = m_log.RegisterSite("SwerveModule::SetDesiredState", __LINE__, m_name);
     }
-
-    static const std::string FuncModule = "SwerveModule::SetDesiredState" + m_name;
+    m_logData.Int(ESwerveModuleLogData::eOutputReverse) = bOutputReverse;
     m_logData[ESwerveModuleLogData::eDesiredAngle] = state.angle.Radians().to<double>();
-    m_logData[ESwerveModuleLogData::eTurnEncVolts] = m_turningEncoder.GetVoltage();
+    m_logData[ESwerveModuleLogData::eTurnEncVolts] = m_sample.m_turnEncVolts;
     m_logData[ESwerveModuleLogData::eTurnEncAngle] = absAngle;
+    m_logData[ESwerveModuleLogData::eTurnEncRate] = m_sample.m_turnEncRate;
+    m_logData[ESwerveModuleLogData::eTurnEncNoise] = m_sample.m_turnEncNoise;
     m_logData[ESwerveModuleLogData::eMinTurnRads] = minTurnRads;
+    m_logData[ESwerveModuleLogData::eTurnFrameError] = m_frameError;
     m_logData[ESwerveModuleLogData::eTurnNeoPidRefPos] = newPosition;
     m_logData[ESwerveModuleLogData::eTurnNeoEncoderPos] = currentPosition;
-    m_logData[ESwerveModuleLogData::eTurnOutputDutyCyc] = m_turningMotor.GetAppliedOutput();
+    m_logData[ESwerveModuleLogData::eTurnOutputDutyCyc] = m_sample.m_turnOutputDutyCyc;
     m_logData[ESwerveModuleLogData::eDrivePidRefSpeed] = state.speed.to<double>();
-    m_logData[ESwerveModuleLogData::eDriveEncVelocity] = m_driveEncoder.GetVelocity();
-    m_logData[ESwerveModuleLogData::eDriveOutputDutyCyc] = m_driveMotor.GetAppliedOutput();
-    m_log.logData<ESwerveModuleLogData>(FuncModule.c_str(), __LINE__, m_logData);
-}
-
-void SwerveModule::ResetEncoders()
-{
-    m_driveEncoder.SetPosition(0.0); 
-}
-
-double SwerveModule::VoltageToRadians(double Voltage, double offset)
-{
-    offset = m_nteAbsEncTuningOffset.GetDouble(m_offset);
-    double angle = fmod(Voltage * DriveConstants::kTurnVoltageToRadians - offset + 2 * wpi::math::pi, 2 * wpi::math::pi);
-    angle = 2 * wpi::math::pi - angle;
+    m_logData[ESwerveModuleLogData::eDriveEncVelocity] = m_sample.m_driveVelocity;
+    m_logData[ESwerveModuleLogData::eDriveSpeedError] = direction * state.speed.to<double>() - m_logData[ESwerveModuleLogData::eDriveEncVelocity];
+    m_logData[ESwerveModuleLogData::eDriveOutputDutyCyc] = m_sample.m_driveOutputDutyCyc;
+    m_logData[ESwerveModuleLogData::eTurnOutputCurrent] = m_sample.m_turnOutputCurrent;
+    m_logData[ESwerveModuleLogData::eDriveOutputCurrent] = m_sample.m_driveOutputCurrent;
+    m_logData[ESwerveModuleLogData::eDriveCanLoad] = m_driveTraffic.GetBusUtilization(now);
+    m_logData[ESwerveModuleLogData::eTurnCanLoad] = m_turnTraffic.GetBusUtilization(now);
+    ActuatorStats driveStats = m_driveTraffic.GetMailbox().GetStats();
+    ActuatorStats turnStats = m_turnTraffic.GetMailbox().GetStats();
+    m_logData[ESwerveModuleLogData::eDriveWriteLatency] = driveStats.m_lastLatency;
+    m_logData[ESwerveModuleLogData::eTurnWriteLatency] = turnStats.m_lastLatency;
+    m_logData[ESwerveModuleLogData::eDriveQueueAge] = driveStats.m_lastQueueAge;
+    m_logData[ESwerveModuleLogData::eTurnQueueAge] = turnStats.m_lastQueueAge;
+    if (LogConstants::kAggregateModuleData)
+    {
+        m_log.logStats<ESwerveModuleLogData>(m_logSiteId, m_logData, m_logStats);
+    }
+    else
+    {
+        m_log.logData<ESwerveModuleLogData>(m_logSiteId, m_logData);
+    }
 
-    return angle;
+    // The angle is left alone while stopped, so only a turn that was asked for counts as an error
+    double turnError = state.speed.to<double>() == 0.0 ? 0.0 : minTurnRads;
+    CheckFaults(turnError, m_sample.m_turnOutputCurrent, m_sample.m_driveOutputCurrent);
 }
 
-double SwerveModule::VoltageToDegrees(double voltage, double offSet)
+template <typename Hw>
+void SwerveModuleT<Hw>::ResyncTurnEncoder(double speed)
 {
-    double angle = fmod(voltage * DriveConstants::KTurnVoltageToDegrees - offSet + 360.0, 360.0);
+    bool bStill = speed == 0.0
+               && fabs(m_sample.m_turnEncRate) < ModuleConstants::kTurnResyncMaxRate
+               && fabs(m_sample.m_driveVelocity) < ModuleConstants::kTurnResyncMaxDriveSpeed;
+    m_stillLoops = bStill ? m_stillLoops + 1 : 0;
 
-    return angle;
-}
+    if (m_stillLoops < ModuleConstants::kTurnResyncStillLoops || fabs(m_frameError) < ModuleConstants::kTurnResyncThreshold)
+    {
+        return;
+    }
 
-// Convert any angle theta in radians to its equivalent on the interval [0, 2pi]
-double SwerveModule::ZeroTo2PiRads(double theta)
-{
-    theta = fmod(theta, 2 * wpi::math::pi);
-    if (theta < 0)
-        theta += 2 * wpi::math::pi;
-        
-    return theta;
-}
+    // Stay on the same turn of the NEO's unwrapped position. The position loop still holds the
+    // last target, so the wheel now settles where that target really is. The write goes through
+    // the mailbox like the setpoints, so it reaches the controller ahead of the next one.
+    m_sample.m_turnNeoPosition += m_frameError;
+    m_turnTraffic.SetEncoderPosition(m_sample.m_turnNeoPosition);
 
-// Convert any angle theta in radians to its equivalent on the interval [-pi, pi]
-double SwerveModule::NegPiToPiRads(double theta)
-{
-    theta = ZeroTo2PiRads(theta);
-    if (theta > wpi::math::pi)
-        theta -= 2 * wpi::math::pi;
-    else if (theta < -1.0 * wpi::math::pi)
-        theta += 2 * wpi::math::pi;
-        
-    return theta;
+    // ReadState adds this to the NEO position between samples, move it to the new frame too
+    m_neoToAbs.store(m_neoToAbs.load(std::memory_order_relaxed) - m_frameError, std::memory_order_relaxed);
+    m_stillLoops = 0;
 }
 
-// Determine the smallest magnitude delta angle that can be added to initial angle that will 
-// result in an angle equivalent (but not necessarily equal) to final angle. 
-// All angles in radians
-// 
-// init final   angle1   angle2 
-double SwerveModule::MinTurnRads(double init, double final, bool& bOutputReverse)
+template <typename Hw>
+void SwerveModuleT<Hw>::CheckFaults(double minTurnRads, double turnCurrent, double driveCurrent)
 {
-    init = ZeroTo2PiRads(init);
-    final = ZeroTo2PiRads(final);
-
-    // The shortest turn angle may be acheived by reversing the motor output direction
-    double angle1 = final - init;
-    double angle2 = final + wpi::math::pi - init;
-
-    angle1 = NegPiToPiRads(angle1);
-    angle2 = NegPiToPiRads(angle2);
+    if (turnCurrent > LogConstants::kFaultCurrentAmps || driveCurrent > LogConstants::kFaultCurrentAmps)
+    {
+        m_log.TriggerFlightRecorder(m_currentFaultReason.c_str());
+    }
 
-    // Choose the smallest angle and determine reverse flag
-    if (fabs(angle1) <= fabs(angle2))
+    if (fabs(minTurnRads) > LogConstants::kFaultTurnErrorRads)
     {
-        bOutputReverse = false;
-        if (angle1 > M_PI)
+        if (++m_turnErrorLoops == LogConstants::kFaultTurnErrorLoops)
         {
-            printf("Angle1: %f Final: %f Init: %f\n", angle1, final, init);
+            m_log.TriggerFlightRecorder(m_turnFaultReason.c_str());
         }
-        return angle1;
-    } 
+    }
     else
     {
-        bOutputReverse = true;
-        return angle2;
+        m_turnErrorLoops = 0;
     }
 }
+
+template <typename Hw>
+void SwerveModuleT<Hw>::ResetEncoders()
+{
+    m_driveTraffic.SetEncoderPosition(0.0);
+}
+
+#ifdef __FRC_ROBORIO__
+template class SwerveModuleT<RobotHardware>;
+#else
+template class SwerveModuleT<SimHardware>;
+#endif
@@ -0,0 +1,102 @@
+/*
+    Angle and rate estimate for an absolute encoder that wraps
+
+    An alpha-beta filter on the circle: the innovation is taken as the shortest way around
+    from the prediction to the measurement, so a reading that wraps from 2pi to 0 is a small
+    step, not a full turn. Hardware averaging of the analog voltage does not know about the
+    wrap (half the samples at 0 V and half at 4.93 V average to a wheel pointing the wrong
+    way), so IsAverageValid says when the angle expected for the next reading is far enough
+    from the wrap to trust an averaged reading.
+
+    Measurements carry their latency, the age of the middle of the averaging window. The
+    innovation is taken against the estimate at that age, so the estimate itself is for the
+    time it is updated at. GetLatency reports the compensated latency of the last reading.
+*/
+
+#pragma once
+
+#include <cmath>
+
+#include "AngleMath.h"
+
+class AbsoluteAngleFilter
+{
+public:
+    /// @param alpha        Share of the angle innovation taken, 0 to 1
+    /// @param beta         Share of the innovation per update period taken into the rate
+    /// @param wrapMargin   Radians kept clear of the wrap before an averaged reading is trusted
+    AbsoluteAngleFilter(double alpha, double beta, double wrapMargin)
+        : m_alpha(alpha)
+        , m_beta(beta)
+        , m_wrapMargin(wrapMargin)
+    {
+    }
+
+    /// True if a reading taken at now, averaged over window seconds, is expected to stay clear
+    /// of wrapAngle, the angle at which the sensor voltage wraps
+    bool IsAverageValid(double now, double window, double wrapAngle) const
+    {
+        if (!m_bInitialized)
+        {
+            return false;
+        }
+
+        double predicted = m_angle + m_rate * (now - m_timestamp);
+        double margin = m_wrapMargin + fabs(m_rate) * window;
+
+        return fabs(AngleMath::NegPiToPi(predicted - wrapAngle)) > margin;
+    }
+
+    /// @param angle        Measured angle, radians, any range
+    /// @param timestamp    When the reading was taken, seconds
+    /// @param latency      How long before timestamp the reading represents, seconds
+    void Update(double angle, double timestamp, double latency)
+    {
+        if (!m_bInitialized)
+        {
+            m_angle = AngleMath::ZeroTo2Pi(angle);
+            m_timestamp = timestamp;
+            m_bInitialized = true;
+            return;
+        }
+
+        double dt = timestamp - m_timestamp;
+        if (dt <= 0.0)
+        {
+            return;
+        }
+
+        double predicted = m_angle + m_rate * dt;
+        double innovation = AngleMath::NegPiToPi(angle - (predicted - m_rate * latency));
+
+        m_angle = AngleMath::ZeroTo2Pi(predicted + m_alpha * innovation);
+        m_rate += m_beta * innovation / dt;
+        m_timestamp = timestamp;
+        m_latency = latency;
+
+        m_noiseVariance += c_noiseGain * (innovation * innovation - m_noiseVariance);
+    }
+
+    /// Radians on [0, 2pi)
+    double GetAngle() const { return m_angle; }
+    /// Radians per second
+    double GetRate() const { return m_rate; }
+    /// Standard deviation of the innovation, radians. Includes unmodelled motion as well as sensor noise.
+    double GetNoise() const { return sqrt(m_noiseVariance); }
+    /// Age of the last reading compensated for, seconds
+    double GetLatency() const { return m_latency; }
+
+private:
+    static constexpr double c_noiseGain = 0.02;     //!< About a 1 s time constant at 50 Hz
+
+    double m_alpha;
+    double m_beta;
+    double m_wrapMargin;
+
+    bool m_bInitialized = false;
+    double m_angle = 0.0;
+    double m_rate = 0.0;
+    double m_timestamp = 0.0;
+    double m_latency = 0.0;
+    double m_noiseVariance = 0.0;
+};
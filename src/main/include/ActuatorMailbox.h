@@ -0,0 +1,150 @@
+/*
+    Latest setpoint of one motor controller, handed from the control loop to the CAN I/O thread
+
+    Post stores the command and returns; it never makes a vendor call in async mode. The I/O
+    thread (ActuatorWorker) calls Drain, which sends the newest command if there is one. A
+    command posted again before the last one went out replaces it, so a stalled bus only ever
+    delays the newest setpoint and nothing queues up. Without a worker (the simulation, which
+    must see setpoints in lockstep) Post sends at once.
+
+    PostEncoderPosition re-zeros the controller's integrated encoder the same way. It is never
+    replaced by a setpoint: Drain sends it first, so setpoints posted after it reach the
+    controller after the encoder has moved to the new frame.
+
+    Drain keeps per device statistics, the time spent in the vendor call and the age of the
+    command when it was sent, readable from any thread.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "hardware/HardwareInterfaces.h"
+#include "SeqLock.h"
+#include "Trace.h"
+
+struct ActuatorStats
+{
+    uint32_t m_writes = 0;
+    uint32_t m_overwritten = 0;     //!< Commands replaced before they were sent
+    double m_lastLatency = 0.0;     //!< Seconds spent in the last vendor call
+    double m_meanLatency = 0.0;
+    double m_maxLatency = 0.0;
+    double m_lastQueueAge = 0.0;    //!< Seconds from Post to the start of the last vendor call
+    double m_maxQueueAge = 0.0;
+};
+
+template <typename Motor, typename Encoder>
+class ActuatorMailbox
+{
+public:
+    ActuatorMailbox(Motor& motor, Encoder& encoder)
+        : m_motor(motor)
+        , m_encoder(encoder)
+    {
+    }
+
+    /// Hands the commands to an I/O thread from now on. Call before the thread starts.
+    void SetAsync() { m_bAsync = true; }
+
+    /// Control loop side
+    void Post(double value, EMotorControl mode)
+    {
+        m_command.Write({ value, mode, Now() });
+        m_posted.fetch_add(1, std::memory_order_release);
+
+        if (!m_bAsync)
+        {
+            Drain();
+        }
+    }
+
+    /// Control loop side
+    void PostEncoderPosition(double position)
+    {
+        m_encoderPosition.Write(position);
+        m_encoderPosted.fetch_add(1, std::memory_order_release);
+
+        if (!m_bAsync)
+        {
+            Drain();
+        }
+    }
+
+    /// I/O side: sends a new encoder position, then the newest command if it has not been sent.
+    /// Returns true if anything was sent.
+    bool Drain()
+    {
+        // The setpoint count first: a setpoint posted after an encoder position brings it along
+        uint32_t posted = m_posted.load(std::memory_order_acquire);
+        uint32_t encoderPosted = m_encoderPosted.load(std::memory_order_acquire);
+        bool bEncoderSent = false;
+        if (encoderPosted != m_encoderTaken)
+        {
+            m_encoderTaken = encoderPosted;
+            double position = m_encoderPosition.Read();
+            TRACE_CALL("CANEncoder::SetPosition", m_encoder.SetPosition(position));
+            bEncoderSent = true;
+        }
+
+        if (posted == m_taken)
+        {
+            return bEncoderSent;
+        }
+
+        // A Post landing between here and the Read is sent now and once more next Drain
+        m_stats.m_overwritten += posted - m_taken - 1;
+        m_taken = posted;
+        Command command = m_command.Read();
+
+        double start = Now();
+        TRACE_CALL("CANPIDController::SetReference", m_motor.SetReference(command.m_value, command.m_mode));
+        double end = Now();
+
+        double latency = end - start;
+        double age = start - command.m_posted;
+        m_stats.m_writes++;
+        m_stats.m_lastLatency = latency;
+        m_stats.m_meanLatency += (latency - m_stats.m_meanLatency) / m_stats.m_writes;
+        m_stats.m_maxLatency = std::max(m_stats.m_maxLatency, latency);
+        m_stats.m_lastQueueAge = age;
+        m_stats.m_maxQueueAge = std::max(m_stats.m_maxQueueAge, age);
+        m_publishedStats.Write(m_stats);
+
+        return true;
+    }
+
+    /// Any thread
+    ActuatorStats GetStats() const { return m_publishedStats.Read(); }
+
+private:
+    struct Command
+    {
+        double m_value;
+        EMotorControl m_mode;
+        double m_posted;        //!< Now() at Post
+    };
+
+    static double Now()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    Motor& m_motor;
+    Encoder& m_encoder;
+    bool m_bAsync = false;
+
+    SeqLock<Command> m_command;
+    std::atomic<uint32_t> m_posted{0};      //!< Commands posted so far
+    uint32_t m_taken = 0;                   //!< m_posted at the last Drain, I/O side only
+
+    SeqLock<double> m_encoderPosition;
+    std::atomic<uint32_t> m_encoderPosted{0};
+    uint32_t m_encoderTaken = 0;            //!< I/O side only
+
+    ActuatorStats m_stats;                  //!< I/O side only
+    SeqLock<ActuatorStats> m_publishedStats;
+};
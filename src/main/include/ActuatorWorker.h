@@ -0,0 +1,60 @@
+/*
+    CAN I/O thread for actuator commands
+
+    Drains a fixed set of ActuatorMailboxes, making the vendor calls off the control loop.
+    The loop posts its setpoints and calls Wake once; the thread then sends whatever is new.
+    Mailboxes are added before Start and stay registered until the worker is destroyed,
+    which stops the thread, so the worker has to go before its mailboxes do.
+*/
+
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+class ActuatorWorker
+{
+public:
+    ActuatorWorker() = default;
+    ActuatorWorker(const ActuatorWorker&) = delete;
+    ActuatorWorker& operator=(const ActuatorWorker&) = delete;
+    ~ActuatorWorker();
+
+    /// Registers a mailbox and switches it to async mode. Call before Start.
+    template <typename Mailbox>
+    void Add(Mailbox& mailbox)
+    {
+        assert(m_numEntries < c_maxMailboxes);
+        mailbox.SetAsync();
+        m_entries[m_numEntries++] = { &mailbox, [](void* p) { return static_cast<Mailbox*>(p)->Drain(); } };
+    }
+
+    void Start();
+
+    /// Control loop side, once the loop's commands are posted
+    void Wake();
+
+private:
+    static constexpr size_t c_maxMailboxes = 16;
+
+    struct Entry
+    {
+        void* m_mailbox;
+        bool (*m_drain)(void*);
+    };
+
+    void Run();
+
+    std::array<Entry, c_maxMailboxes> m_entries;
+    size_t m_numEntries = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_bWoken = false;          //!< Guarded by m_mutex
+    bool m_bRun = false;            //!< Guarded by m_mutex
+    std::thread m_thread;
+};
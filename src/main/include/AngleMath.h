@@ -0,0 +1,90 @@
+/*
+    Angle wrapping without fmod or data dependent branches
+
+    Wraps use one multiply, one floor/ceil and one multiply-add. The batch versions are
+    plain loops over all modules at once, written so the compiler can vectorize them on
+    targets with double precision SIMD.
+
+    The ranges given hold to within rounding: an angle a hair from a wrap point can land on it
+    or just past it, e.g. ZeroTo2Pi(-1e-300) is 2pi, as it was with the fmod versions.
+*/
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+namespace AngleMath
+{
+    constexpr double c_pi = 3.14159265358979323846;
+    constexpr double c_2pi = 2.0 * c_pi;
+    constexpr double c_inv2pi = 1.0 / c_2pi;
+
+    /// Any angle in radians to its equivalent on [0, 2pi)
+    inline double ZeroTo2Pi(double theta)
+    {
+        return theta - c_2pi * std::floor(theta * c_inv2pi);
+    }
+
+    /// Any angle in radians to its equivalent on (-pi, pi]
+    inline double NegPiToPi(double theta)
+    {
+        return theta - c_2pi * std::ceil(theta * c_inv2pi - 0.5);
+    }
+
+    /// Any value to its equivalent on [0, period), e.g. degrees with period 360
+    inline double ZeroToPeriod(double value, double period)
+    {
+        return value - period * std::floor(value / period);
+    }
+
+    /// Smallest magnitude delta that can be added to init to end up equivalent to final,
+    /// allowing the wheel to reverse its drive output (a half turn plus reversing is the same
+    /// wheel direction). All angles in radians, the result is on (-pi, pi].
+    inline double MinTurnRads(double init, double final, bool& bOutputReverse)
+    {
+        double angle1 = NegPiToPi(final - init);
+        double angle2 = NegPiToPi(final - init + c_pi);
+        bOutputReverse = std::fabs(angle2) < std::fabs(angle1);
+
+        return bOutputReverse ? angle2 : angle1;
+    }
+
+    /// Absolute encoder voltage to wheel angle in radians on (0, 2pi], the encoder counts backwards
+    inline double VoltageToRadians(double volts, double radiansPerVolt, double offset)
+    {
+        return c_2pi - ZeroTo2Pi(volts * radiansPerVolt - offset);
+    }
+
+    /// Absolute encoder voltage to degrees on [0, 360)
+    inline double VoltageToDegrees(double volts, double degreesPerVolt, double offset)
+    {
+        return ZeroToPeriod(volts * degreesPerVolt - offset, 360.0);
+    }
+
+    /// MinTurnRads for N modules at once
+    template <size_t N>
+    inline void MinTurnRads(const std::array<double, N>& init, const std::array<double, N>& final
+                          , std::array<double, N>& delta, std::array<bool, N>& bOutputReverse)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            double angle1 = NegPiToPi(final[i] - init[i]);
+            double angle2 = NegPiToPi(final[i] - init[i] + c_pi);
+            bOutputReverse[i] = std::fabs(angle2) < std::fabs(angle1);
+            delta[i] = bOutputReverse[i] ? angle2 : angle1;
+        }
+    }
+
+    /// VoltageToRadians for N modules at once
+    template <size_t N>
+    inline void VoltageToRadians(const std::array<double, N>& volts, double radiansPerVolt
+                               , const std::array<double, N>& offset, std::array<double, N>& angle)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            angle[i] = c_2pi - ZeroTo2Pi(volts[i] * radiansPerVolt - offset[i]);
+        }
+    }
+}
@@ -0,0 +1,46 @@
+/*
+    Binary log format for LogDataT streams
+
+    File layout (all values little endian, no padding):
+
+        File header     char[8] magic "SWLOGBIN", uint32 version
+
+        Schema block    uint8 tag 1
+                        uint16 stream id
+                        uint16 number of ints, uint16 number of doubles
+                        uint16 name length, name bytes
+                        per field (ints first, then doubles): uint16 name length, name bytes
+
+        Record block    uint8 tag 2
+                        uint16 stream id
+                        int64 timestamp in microseconds (FPGA time)
+                        int32[number of ints], double[number of doubles]
+
+    The file is opened in append mode, so a new file header (segment) can follow any
+    block. Stream ids are only valid inside their segment. A schema block precedes the
+    first record of its stream in every segment, so each segment can be decoded on its
+    own. Records are fixed width per stream.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace BinaryLog
+{
+    constexpr char c_magic[8] = { 'S', 'W', 'L', 'O', 'G', 'B', 'I', 'N' };
+    constexpr uint32_t c_version = 1;
+
+    constexpr uint8_t c_tagSchema = 1;
+    constexpr uint8_t c_tagRecord = 2;
+
+    constexpr size_t c_fileHeaderSize = sizeof(c_magic) + sizeof(uint32_t);
+    constexpr size_t c_recordHeaderSize = sizeof(uint8_t) + sizeof(uint16_t) + sizeof(int64_t);
+
+    /// Size of the int and double payload of one record
+    constexpr size_t PayloadSize(size_t numInts, size_t numDoubles)
+    {
+        return numInts * sizeof(int32_t) + numDoubles * sizeof(double);
+    }
+}
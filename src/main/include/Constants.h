@@ -11,6 +11,9 @@
 #include <units/units.h>
 #include <wpi/math>
 
+#include <array>
+#include <cstddef>
+
 #pragma once
 
 /**
@@ -60,6 +63,14 @@ namespace DriveConstants
 
     constexpr bool kGyroReversed = false;
 
+    // With kOdometryThread the pose is updated on its own thread at kOdometryHz from the drive
+    // and turn NEO encoders, instead of once a loop in DriveSubsystem::Periodic. Real hardware
+    // only, a simulated world only moves in Periodic.
+    constexpr bool kOdometryThread = true;
+    constexpr double kOdometryHz = 200.0;
+    // Odometry updates kept for late measurements, 1.28 s at 200 Hz, 5 s in Periodic
+    constexpr size_t kPoseHistoryLength = 256;
+
     // These are example values only - DO NOT USE THESE FOR YOUR OWN ROBOT!
     // These characterization values MUST be determined either experimentally or
     // theoretically for *your* robot's drive. The RobotPy Characterization
@@ -87,6 +98,36 @@ namespace DriveConstants
     //constexpr double kDriveGearRatio = 8.16;                //!< MK3 swerve modules w/NEOs 12.1 ft/sec
     //constexpr double kDriveGearRatio = 6.86;                //!< MK3 swerve modules w/NEOs 14.4 ft/sec
     constexpr double kTurnMotorRevsPerWheelRev = 18.0;
+
+    constexpr double kTrackWidth = 21.5 * 0.0254;           //!< Meters between centers of right and left wheels
+    constexpr double kWheelBase = 23.5 * 0.0254;            //!< Meters between centers of front and back wheels
+
+    struct SwerveModuleConfig
+    {
+        const char* m_name;
+        int m_driveMotorPort;
+        int m_turningMotorPort;
+        int m_driveEncoderPort;
+        int m_turningEncoderPort;
+        bool m_driveMotorReversed;
+        bool m_turningEncoderReversed;
+        double m_offset;
+        double m_x;                     //!< Meters from the robot center, +x forward
+        double m_y;                     //!< Meters from the robot center, +y left
+    };
+
+    /// The drivetrain's modules, in kinematics order. Everything indexed by module follows this order.
+    constexpr std::array<SwerveModuleConfig, kNumSwerveModules> kModuleConfigs =
+    {{
+          { "FrontLeft",  kFrontLeftDriveMotorPort,  kFrontLeftTurningMotorPort,  kFrontLeftDriveEncoderPort,  kFrontLeftTurningEncoderPort
+                        , kFrontLeftDriveMotorReversed,  kFrontLeftTurningEncoderReversed,  kFrontLeftOffset,   kWheelBase / 2,  kTrackWidth / 2 }
+        , { "FrontRight", kFrontRightDriveMotorPort, kFrontRightTurningMotorPort, kFrontRightDriveEncoderPort, kFrontRightTurningEncoderPort
+                        , kFrontRightDriveMotorReversed, kFrontRightTurningEncoderReversed, kFrontRightOffset,  kWheelBase / 2, -kTrackWidth / 2 }
+        , { "RearLeft",   kRearLeftDriveMotorPort,   kRearLeftTurningMotorPort,   kRearLeftDriveEncoderPort,   kRearLeftTurningEncoderPort
+                        , kRearLeftDriveMotorReversed,   kRearLeftTurningEncoderReversed,   kRearLeftOffset,   -kWheelBase / 2,  kTrackWidth / 2 }
+        , { "RearRight",  kRearRightDriveMotorPort,  kRearRightTurningMotorPort,  kRearRightDriveEncoderPort,  kRearRightTurningEncoderPort
+                        , kRearRightDriveMotorReversed,  kRearRightTurningEncoderReversed,  kRearRightOffset,  -kWheelBase / 2, -kTrackWidth / 2 }
+    }};
 }  // namespace DriveConstants
 
 namespace ModuleConstants
@@ -105,8 +146,100 @@ namespace ModuleConstants
     constexpr double kPModuleDriveController = 0.001;
 
     constexpr uint kMotorCurrentLimit = 30;
+
+    // Absolute encoder acquisition. With kAbsEncoderFiltered the angle comes from
+    // AbsoluteAngleFilter fed with hardware averaged readings (128 samples, 2.6 ms at 50 kS/s)
+    // away from the voltage wrap; otherwise it is a single sample, as before.
+    constexpr bool kAbsEncoderFiltered = true;
+    constexpr int kAbsEncoderOversampleBits = 3;
+    constexpr int kAbsEncoderAverageBits = 4;
+    constexpr double kAbsEncoderFilterAlpha = 0.6;
+    constexpr double kAbsEncoderFilterBeta = 0.25;
+    constexpr double kAbsEncoderWrapMargin = 0.2;       // Radians
+
+    // With kTurnInNeoFrame the turn target is worked out on the turn NEO's encoder, so the
+    // Spark MAX position loop never sees absolute encoder noise. The NEO encoder is set back to
+    // the absolute angle when the module has been still for kTurnResyncStillLoops and the two
+    // disagree by more than kTurnResyncThreshold. Otherwise the target comes from the absolute
+    // encoder every loop.
+    constexpr bool kTurnInNeoFrame = true;
+    constexpr double kTurnResyncThreshold = 0.05;       // Radians
+    constexpr double kTurnResyncMaxRate = 0.05;         // Radians per second, steering counts as still below this
+    constexpr double kTurnResyncMaxDriveSpeed = 0.02;   // Meters per second, driving counts as still below this
+    constexpr int kTurnResyncStillLoops = 10;
 }   // namespace ModuleConstants
 
+namespace CanConstants
+{
+    // Spark MAX status frame periods, ms. Only what SwerveModule::Sample reads comes at loop rate.
+    constexpr int kStatus0PeriodMs = 20;            // Applied output, faults
+    constexpr int kStatus1PeriodMs = 20;            // Velocity, current, temperature, bus voltage
+    constexpr int kDriveStatus2PeriodMs = 500;      // Drive position, not used in the loop
+    constexpr int kTurnStatus2PeriodMs = 20;        // Turn position, used by the turn control
+    // With an odometry thread, drive velocity and turn position come at the odometry rate instead
+    constexpr int kOdometryStatusPeriodMs = static_cast<int>(1000.0 / DriveConstants::kOdometryHz);
+
+    // Pigeon status frame periods, ms. Heading and rate come once a loop, or at the odometry
+    // rate with an odometry thread; nothing reads the rest.
+    constexpr int kPigeonStatusPeriodMs = 20;
+    constexpr int kPigeonUnusedStatusPeriodMs = 100;
+
+    // With kActuatorThread setpoints are sent by an ActuatorWorker thread, so a stalled bus
+    // cannot hold up the loop. Real hardware only, the simulation needs them in lockstep.
+    constexpr bool kActuatorThread = true;
+
+    // Setpoints are only re-sent when they change by more than this, or after kSetpointKeepAlive seconds
+    constexpr double kDriveSetpointTolerance = 0.005;   // m/s
+    constexpr double kTurnSetpointTolerance = 0.001;    // radians
+    constexpr double kSetpointKeepAlive = 0.1;
+}   // namespace CanConstants
+
+namespace LogConstants
+{
+    constexpr double kLoopsPerSecond = 50.0;
+    constexpr double kFlightRecorderSeconds = 10.0;     // Full rate history kept in RAM
+    constexpr int kDataDecimation = 5;                  // The log file gets every 5th sample, 10 Hz
+
+    // Log per field min/max/mean/stddev/percentiles of the swerve modules once a window
+    // instead of the raw samples. The flight recorder only sees raw samples.
+    constexpr bool kAggregateModuleData = false;
+    constexpr double kStatsWindowSeconds = 1.0;
+
+    // Flight recorder triggers
+    constexpr double kFaultCurrentAmps = 1.2 * ModuleConstants::kMotorCurrentLimit;  // Beyond what the smart current limit should allow
+    constexpr double kFaultTurnErrorRads = 0.5;
+    constexpr int kFaultTurnErrorLoops = 25;            // Turn error has to persist half a second
+
+    constexpr const char* kTraceFile = "/home/lvuser/logs/trace.json";  // Chrome trace of the last few seconds
+}   // namespace LogConstants
+
+namespace SimConstants
+{
+    constexpr double kLoopPeriod = 1.0 / LogConstants::kLoopsPerSecond;   // Sim time advanced per DriveSubsystem::Periodic
+    constexpr int kStepsPerLoop = 20;                   // 1 kHz, the Spark MAX control loop rate
+
+    constexpr double kBatteryVolts = 12.0;
+
+    // NEO
+    constexpr double kNeoStallTorque = 2.6;             // Nm
+    constexpr double kNeoStallCurrent = 105.0;          // A
+    constexpr double kNeoFreeSpeedRpm = 5676.0;
+    constexpr double kNeoFreeCurrent = 1.8;             // A
+    constexpr double kNeoRotorInertia = 5.0e-5;         // kg m^2, rotor plus first gear stage
+
+    constexpr double kRobotMassKg = 50.0;
+    constexpr double kRobotMomentOfInertia = 3.0;       // kg m^2 about the center
+    constexpr double kWheelFrictionCoeff = 1.0;         // Tread on carpet, limits traction and side load
+    constexpr double kRollingResistanceCoeff = 0.02;
+    constexpr double kSteerInertia = 0.004;             // kg m^2, module wheel and fork about the steering axis
+    constexpr double kSteerFrictionTorque = 0.5;        // Nm, tread scrub when steering
+    constexpr double kSteerViscousFriction = 0.05;      // Nm per rad/s
+
+    constexpr double kAbsEncoderNoiseVolts = 0.003;     // 1 sigma, per sample
+    constexpr double kAnalogSampleRate = 50000.0;       // Per channel, the roboRIO default
+    constexpr unsigned kRandomSeed = 1259;              // Same noise every run
+}   // namespace SimConstants
+
 namespace AutoConstants
 {
     using radians_per_second_squared_t = units::compound_unit<units::radians, units::inverse<units::squared<units::second>>>;
@@ -121,6 +254,9 @@ namespace AutoConstants
     constexpr double kPThetaController = 0.5;
 
     extern const frc::TrapezoidProfile<units::radians>::Constraints kThetaControllerConstraints;
+
+    // Generated trajectories are kept here, in the deploy directory, and regenerated when their waypoints or config change
+    constexpr const char* kTrajectoryCacheFile = "trajectories.bin";
 }  // namespace AutoConstants
 
 namespace OIConstants
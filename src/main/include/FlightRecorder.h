@@ -0,0 +1,91 @@
+/*
+    Flight recorder
+    Keeps the last window of every binary log stream at full rate in RAM, each stream's ring
+    sized from the rate it is logged at, so a fault can be written out at full resolution while
+    the normal log is decimated.
+
+    Owned by whichever thread writes the log files (the writer thread in async mode).
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+class FlightRecorder
+{
+public:
+    /// @param seconds  History kept per stream, 0 disables the recorder
+    void SetWindow(double seconds) { m_window = seconds; }
+    bool IsEnabled() const { return m_window > 0.0; }
+
+    /// Stores one sample, overwriting the oldest once the stream's ring is full.
+    /// The ring is allocated the first time a stream is seen, with room for the window at sampleRate.
+    void Record(int streamId, double sampleRate, double timestamp, const void* ints, size_t intBytes, const void* doubles, size_t doubleBytes)
+    {
+        if ((size_t)streamId >= m_rings.size())
+        {
+            m_rings.resize(streamId + 1);
+        }
+
+        Ring& ring = m_rings[streamId];
+        if (ring.m_data.empty())
+        {
+            ring.m_capacity = std::max<size_t>(1, static_cast<size_t>(m_window * sampleRate));
+            ring.m_sampleSize = sizeof(double) + intBytes + doubleBytes;
+            ring.m_data.resize(ring.m_sampleSize * ring.m_capacity);
+        }
+
+        unsigned char* out = &ring.m_data[ring.m_next * ring.m_sampleSize];
+        memcpy(out, &timestamp, sizeof(timestamp));
+        memcpy(out + sizeof(timestamp), ints, intBytes);
+        memcpy(out + sizeof(timestamp) + intBytes, doubles, doubleBytes);
+
+        ring.m_next = (ring.m_next + 1) % ring.m_capacity;
+        if (ring.m_count < ring.m_capacity)
+        {
+            ring.m_count++;
+        }
+    }
+
+    int GetNumStreams() const { return m_rings.size(); }
+
+    /// Samples stored for the stream
+    size_t GetCount(int streamId) const { return m_rings[streamId].m_count; }
+
+    /// Calls f(timestamp, payload) for each stored sample of the stream, oldest first.
+    /// The payload holds the ints followed by the doubles.
+    template <typename F>
+    void ForEachSample(int streamId, F&& f) const
+    {
+        const Ring& ring = m_rings[streamId];
+        if (ring.m_count == 0)
+        {
+            return;                 // Never recorded, no ring allocated
+        }
+
+        size_t index = (ring.m_next + ring.m_capacity - ring.m_count) % ring.m_capacity;
+        for (size_t i = 0; i < ring.m_count; i++)
+        {
+            const unsigned char* sample = &ring.m_data[index * ring.m_sampleSize];
+            double timestamp;
+            memcpy(&timestamp, sample, sizeof(timestamp));
+            f(timestamp, sample + sizeof(timestamp));
+            index = (index + 1) % ring.m_capacity;
+        }
+    }
+
+private:
+    struct Ring
+    {
+        std::vector<unsigned char> m_data;
+        size_t m_capacity = 0;          //!< Samples
+        size_t m_sampleSize = 0;
+        size_t m_next = 0;
+        size_t m_count = 0;
+    };
+
+    double m_window = 0.0;          //!< Seconds
+    std::vector<Ring> m_rings;      //!< Indexed by stream id
+};
@@ -0,0 +1,77 @@
+/*
+    Cached gyro readings
+
+    The gyro is read once per sample, from the odometry thread or from DriveSubsystem::Periodic,
+    and every other user gets the cached heading, yaw rate and the time they were read at.
+    The cache is a SeqLock, so readers on any thread never wait on a sample or the CAN bus.
+
+    The heading is zeroed in software: the zero is an offset applied to the cached reading, so
+    it takes effect at once and a sample in flight cannot undo it. Gyro is a GyroInterface.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cmath>
+
+#include "hardware/HardwareInterfaces.h"
+#include "SeqLock.h"
+#include "Trace.h"
+
+template <typename Gyro>
+class GyroService
+{
+public:
+    struct Sample
+    {
+        double m_heading;       //!< Degrees, counter clockwise positive, continuous, before the zero offset
+        double m_rate;          //!< Degrees per second, counter clockwise positive
+        double m_timestamp;     //!< Seconds
+    };
+
+    /// Configures the status frame periods and takes the first sample
+    /// @param bReversed        The gyro is mounted upside down
+    /// @param samplePeriodMs   How often Update is called, ms
+    /// @param unusedPeriodMs   Period of the status frames nothing here reads, ms
+    GyroService(Gyro& gyro, bool bReversed, int samplePeriodMs, int unusedPeriodMs, double timestamp)
+        : m_gyro(gyro)
+        , m_sign(bReversed ? -1.0 : 1.0)
+        , m_cache(Sample{0.0, 0.0, 0.0})
+    {
+        m_gyro.ClearStickyFaults();
+        m_gyro.SetStatusFramePeriods(samplePeriodMs, unusedPeriodMs);
+        Update(timestamp);
+    }
+
+    /// Reads the gyro. Call from one thread only.
+    void Update(double timestamp)
+    {
+        double heading = TRACE_CALL("PigeonIMU::GetFusedHeading", m_gyro.GetFusedHeading());
+        double rate = TRACE_CALL("PigeonIMU::GetRawGyro", m_gyro.GetYawRate());
+        m_cache.Write({ m_sign * heading, m_sign * rate, timestamp });
+    }
+
+    /// Makes the current heading zero
+    void Zero()
+    {
+        m_zero.store(m_cache.Read().m_heading, std::memory_order_relaxed);
+    }
+
+    /// Degrees, -180 to 180
+    double GetHeading() const
+    {
+        return std::remainder(m_cache.Read().m_heading - m_zero.load(std::memory_order_relaxed), 360.0);
+    }
+
+    /// Degrees per second
+    double GetTurnRate() const { return m_cache.Read().m_rate; }
+
+    /// When the cached values were read, seconds
+    double GetTimestamp() const { return m_cache.Read().m_timestamp; }
+
+private:
+    GyroInterface<Gyro>& m_gyro;
+    double m_sign;
+    SeqLock<Sample> m_cache;
+    std::atomic<double> m_zero{0.0};    //!< Heading made zero by Zero, degrees
+};
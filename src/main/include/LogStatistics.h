@@ -0,0 +1,286 @@
+/*
+    Streaming statistics for LogDataT fields
+
+    Summarizes every double field of a LogDataT over a time window (min, max, mean,
+    standard deviation and approximate percentiles) so the log can carry one summary
+    per window instead of every raw sample. Each sample costs a fixed amount of work
+    per field and nothing is allocated after construction.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+template <typename E>
+class LogDataT;
+
+/// Online min, max, mean and variance (Welford)
+class RunningStats
+{
+public:
+    void Add(double x)
+    {
+        m_count++;
+        double delta = x - m_mean;
+        m_mean += delta / m_count;
+        m_m2 += delta * (x - m_mean);
+        m_min = std::min(m_min, x);
+        m_max = std::max(m_max, x);
+    }
+
+    void Reset() { *this = RunningStats(); }
+
+    int GetCount() const { return m_count; }
+    double GetMin() const { return m_count > 0 ? m_min : 0.0; }
+    double GetMax() const { return m_count > 0 ? m_max : 0.0; }
+    double GetMean() const { return m_mean; }
+    double GetVariance() const { return m_count > 1 ? m_m2 / (m_count - 1) : 0.0; }
+    double GetStdDev() const { return sqrt(GetVariance()); }
+
+private:
+    int m_count = 0;
+    double m_mean = 0.0;
+    double m_m2 = 0.0;
+    double m_min = std::numeric_limits<double>::infinity();
+    double m_max = -std::numeric_limits<double>::infinity();
+};
+
+/// Approximate quantile with five markers and no stored samples (the P-square algorithm, Jain and Chlamtac)
+class P2Quantile
+{
+public:
+    explicit P2Quantile(double p = 0.5)
+        : m_p(p)
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        m_count = 0;
+        for (int i = 0; i < 5; i++)
+        {
+            m_n[i] = i;
+        }
+        m_np = { 0.0, 2.0 * m_p, 4.0 * m_p, 2.0 + 2.0 * m_p, 4.0 };
+        m_dn = { 0.0, m_p / 2.0, m_p, (1.0 + m_p) / 2.0, 1.0 };
+    }
+
+    void Add(double x)
+    {
+        // The first five samples become the markers
+        if (m_count < 5)
+        {
+            m_q[m_count++] = x;
+            if (m_count == 5)
+            {
+                std::sort(m_q.begin(), m_q.end());
+            }
+            return;
+        }
+        m_count++;
+
+        // Find the cell x falls in, stretching the end markers if needed
+        int k;
+        if (x < m_q[0])
+        {
+            m_q[0] = x;
+            k = 0;
+        }
+        else if (x >= m_q[4])
+        {
+            m_q[4] = x;
+            k = 3;
+        }
+        else
+        {
+            k = 0;
+            while (x >= m_q[k + 1])
+            {
+                k++;
+            }
+        }
+
+        for (int i = k + 1; i < 5; i++)
+        {
+            m_n[i]++;
+        }
+        for (int i = 0; i < 5; i++)
+        {
+            m_np[i] += m_dn[i];
+        }
+
+        // Move the middle markers toward their desired positions
+        for (int i = 1; i < 4; i++)
+        {
+            double d = m_np[i] - m_n[i];
+            if ((d >= 1.0 && m_n[i + 1] - m_n[i] > 1) || (d <= -1.0 && m_n[i - 1] - m_n[i] < -1))
+            {
+                int step = d > 0.0 ? 1 : -1;
+                double q = Parabolic(i, step);
+                if (m_q[i - 1] < q && q < m_q[i + 1])
+                {
+                    m_q[i] = q;
+                }
+                else
+                {
+                    m_q[i] += step * (m_q[i + step] - m_q[i]) / (m_n[i + step] - m_n[i]);
+                }
+                m_n[i] += step;
+            }
+        }
+    }
+
+    double Get() const
+    {
+        if (m_count >= 5)
+        {
+            return m_q[2];
+        }
+        if (m_count == 0)
+        {
+            return 0.0;
+        }
+
+        // Too few samples for the markers, use the nearest rank
+        std::array<double, 5> sorted = m_q;
+        std::sort(sorted.begin(), sorted.begin() + m_count);
+        return sorted[static_cast<int>(m_p * (m_count - 1) + 0.5)];
+    }
+
+private:
+    double Parabolic(int i, int d) const
+    {
+        return m_q[i] + d / static_cast<double>(m_n[i + 1] - m_n[i - 1])
+            * ((m_n[i] - m_n[i - 1] + d) * (m_q[i + 1] - m_q[i]) / (m_n[i + 1] - m_n[i])
+             + (m_n[i + 1] - m_n[i] - d) * (m_q[i] - m_q[i - 1]) / (m_n[i] - m_n[i - 1]));
+    }
+
+    double m_p;
+    int m_count = 0;
+    std::array<double, 5> m_q{};        //!< Marker heights
+    std::array<int, 5> m_n{};           //!< Marker positions
+    std::array<double, 5> m_np{};       //!< Desired marker positions
+    std::array<double, 5> m_dn{};       //!< Desired position increments
+};
+
+/// Summary of one field over one window, logged as one record
+struct LogStatsSummary
+{
+    enum EValue
+    {
+          eMin
+        , eMax
+        , eMean
+        , eStdDev
+        , eP50
+        , eP90
+        , eP99
+        , eNumValues
+    };
+
+    static constexpr const char* c_valueNames[eNumValues] = { "min", "max", "mean", "stdDev", "p50", "p90", "p99" };
+
+    std::array<int, 2> m_ints{};        //!< Field index, sample count
+    std::array<double, eNumValues> m_values{};
+};
+
+/// Windowed statistics for every double field of a LogDataT<E>
+template <typename E>
+class LogStatsT
+{
+public:
+    static constexpr size_t c_numFields = LogDataT<E>::c_numDoubles;
+
+    /// @param windowSeconds    Length of each summary window
+    explicit LogStatsT(double windowSeconds)
+        : m_windowSeconds(windowSeconds)
+    {
+        for (auto& field : m_fields)
+        {
+            field.m_quantiles = { P2Quantile(0.5), P2Quantile(0.9), P2Quantile(0.99) };
+        }
+    }
+
+    /// Adds one sample of every field. Returns true when the sample closed a window,
+    /// the summaries of that window are then available through GetSummary.
+    bool Add(const LogDataT<E>& data, double timestamp)
+    {
+        bool bClosed = false;
+        if (m_windowStart < 0.0)
+        {
+            m_windowStart = timestamp;
+        }
+        else if (timestamp - m_windowStart >= m_windowSeconds)
+        {
+            Summarize();
+            m_windowStart = timestamp;
+            bClosed = true;
+        }
+
+        auto& doubles = data.GetDoubles();
+        for (size_t i = 0; i < c_numFields; i++)
+        {
+            FieldStats& field = m_fields[i];
+            field.m_stats.Add(doubles[i]);
+            for (auto& quantile : field.m_quantiles)
+            {
+                quantile.Add(doubles[i]);
+            }
+        }
+
+        return bClosed;
+    }
+
+    /// Summary of double field i of the last closed window
+    const LogStatsSummary& GetSummary(size_t i) const { return m_summaries[i]; }
+
+    /// Name of double field i
+    static constexpr const char* GetFieldName(size_t i) { return LogDataT<E>::GetFieldName(LogDataT<E>::c_numInts + i); }
+
+    /// Same header and stream bookkeeping as LogDataT
+    bool LoggedHeader(unsigned segment) const { return m_headerSegment == segment; }
+    void SetHeaderLogged(unsigned segment) { m_headerSegment = segment; }
+    int GetStreamId() const { return m_streamId; }
+    void SetStreamId(int streamId) { m_streamId = streamId; }
+
+private:
+    struct FieldStats
+    {
+        RunningStats m_stats;
+        std::array<P2Quantile, 3> m_quantiles;
+    };
+
+    void Summarize()
+    {
+        for (size_t i = 0; i < c_numFields; i++)
+        {
+            FieldStats& field = m_fields[i];
+            LogStatsSummary& summary = m_summaries[i];
+            summary.m_ints = { static_cast<int>(i), field.m_stats.GetCount() };
+            summary.m_values[LogStatsSummary::eMin] = field.m_stats.GetMin();
+            summary.m_values[LogStatsSummary::eMax] = field.m_stats.GetMax();
+            summary.m_values[LogStatsSummary::eMean] = field.m_stats.GetMean();
+            summary.m_values[LogStatsSummary::eStdDev] = field.m_stats.GetStdDev();
+            summary.m_values[LogStatsSummary::eP50] = field.m_quantiles[0].Get();
+            summary.m_values[LogStatsSummary::eP90] = field.m_quantiles[1].Get();
+            summary.m_values[LogStatsSummary::eP99] = field.m_quantiles[2].Get();
+
+            field.m_stats.Reset();
+            for (auto& quantile : field.m_quantiles)
+            {
+                quantile.Reset();
+            }
+        }
+    }
+
+    double m_windowSeconds;
+    double m_windowStart = -1.0;
+    std::array<FieldStats, c_numFields> m_fields;
+    std::array<LogStatsSummary, c_numFields> m_summaries;
+    unsigned m_headerSegment = 0;
+    int m_streamId = -1;
+};
@@ -0,0 +1,111 @@
+/*
+    Log storage manager
+
+    Log files live in a persistent directory instead of /tmp (RAM), one segment per
+    robot mode. Writes are staged in a bounded RAM buffer and go to disk in large
+    sequential chunks, either when a chunk fills or when the flush period expires.
+    Old segments are deleted to keep the directory under a disk space budget.
+
+    Segment files are named <prefix>_<sequence>_<tag>.csv / .bin
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/// One staged output file
+class LogFile
+{
+public:
+    LogFile() = default;
+    ~LogFile();
+
+    LogFile(const LogFile&) = delete;
+    LogFile& operator=(const LogFile&) = delete;
+
+    bool Open(const std::string& path, size_t stagingSize);
+    void Close();
+    bool IsOpen() const { return m_fd >= 0; }
+
+    /// Appends to the staging buffer; data that does not fit even after a flush is dropped and counted
+    void Write(const void* data, size_t len);
+    void Printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    /// Writes the whole staging buffer to disk, returns the number of bytes written
+    size_t Flush();
+
+    size_t GetStaged() const { return m_used; }
+    size_t GetFileSize() const { return m_fileSize; }
+    uint64_t GetDroppedBytes() const { return m_droppedBytes; }
+
+    /// Stop accepting data, used when the disk budget is exhausted
+    void SetFull(bool bFull) { m_bFull = bFull; }
+
+    /// Stop accepting data once the file would grow past this many bytes, 0 for no limit
+    void SetSizeLimit(uint64_t bytes) { m_sizeLimit = bytes; }
+
+private:
+    bool OverLimit(size_t len);
+
+    int m_fd = -1;
+    std::unique_ptr<char[]> m_buffer;
+    size_t m_capacity = 0;
+    size_t m_used = 0;
+    size_t m_fileSize = 0;
+    uint64_t m_droppedBytes = 0;
+    uint64_t m_sizeLimit = 0;
+    bool m_bFull = false;
+};
+
+class LogStorage
+{
+public:
+    struct Config
+    {
+        std::string m_directory = "/home/lvuser/logs";
+        std::string m_prefix = "log";
+        size_t m_stagingSize = 256 * 1024;          //!< RAM staging per file, bytes
+        size_t m_flushChunk = 64 * 1024;            //!< Flush as soon as this much is staged
+        double m_flushPeriod = 2.0;                 //!< Flush a partial chunk at least this often, seconds
+        uint64_t m_diskBudget = 256ull << 20;       //!< Total size of all segments in the directory, bytes
+    };
+
+    explicit LogStorage(const Config& config);
+    ~LogStorage();
+
+    /// Closes the current segment, frees disk space if needed and starts a new segment
+    /// @param tag      Added to the file names, e.g. the robot mode
+    /// @param bBinary  Also open a .bin file for binary data
+    bool Open(const char* tag, bool bBinary);
+    void Close();
+    bool IsOpen() const { return m_text.IsOpen(); }
+
+    /// Opens a one off file (e.g. a flight recorder dump) named like a segment, counted in the disk budget.
+    /// Old segments are deleted to make room for size bytes, the file stops accepting data at the budget.
+    bool OpenExtra(const char* tag, const char* extension, uint64_t size, LogFile& file);
+    /// Closes a file from OpenExtra and adds it to the disk usage
+    void CloseExtra(LogFile& file);
+
+    LogFile& Text() { return m_text; }
+    LogFile& Binary() { return m_binary; }
+
+    /// Flushes full chunks, and partial ones once the flush period has passed
+    /// @param now  Current time in seconds
+    void Poll(double now);
+
+    const std::string& GetTextPath() const { return m_textPath; }
+
+private:
+    void FlushFile(LogFile& file);
+    void EnforceBudget(uint64_t reserve = 0);
+
+    Config m_config;
+    unsigned m_sequence = 0;                //!< Next sequence number
+    unsigned m_currentSequence = 0;         //!< Sequence number of the open segment
+    std::string m_textPath;
+    LogFile m_text;
+    LogFile m_binary;
+    double m_lastFlush = 0.0;
+    uint64_t m_bytesOnDisk = 0;             //!< All segments, as of the last budget check plus what was flushed since
+};
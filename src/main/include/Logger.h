@@ -11,12 +11,27 @@
 #define SRC_Logger_H_
 
 #include <stdio.h>
-#include <frc\timer.h>
+#include <frc/Timer.h>
 #include <frc/shuffleboard/Shuffleboard.h>
 
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <string>
 
+#include "BinaryLogFormat.h"
+#include "FlightRecorder.h"
+#include "LogStatistics.h"
+#include "LogStorage.h"
+#include "NumberFormat.h"
+#include "SpscRingBuffer.h"
+#include "TelemetryPublisher.h"
+
 enum ELogLevel
 {
       eDebug
@@ -32,186 +47,490 @@ class EmptyType
 {
 };
 
+/// One entry of a log data schema: an enum value and the name it is logged under.
+/// The dashboard gets the field when it moved more than m_deadband, at most every m_period seconds.
+template <typename E>
+struct LogField
+{
+  E m_field;
+  const char* m_name;
+  double m_deadband = 0.0;
+  double m_period = 0.1;
+};
+
+/// Specialize for each log data enum. c_fields lists every field, ints then doubles, in enum order:
+///
+///   template <> struct LogDataSchema<EMyLogData>
+///   {
+///     static constexpr LogField<EMyLogData> c_fields[] =
+///     {
+///         { EMyLogData::eSpeed, "speed" }
+///       , { EMyLogData::eAngle, "angle", 0.01, 0.5 }    // Dashboard deadband and period
+///       , ...
+///     };
+///   };
+template <typename E>
+struct LogDataSchema;
+
+template <typename E>
+constexpr bool LogFieldsInEnumOrder()
+{
+  size_t i = 0;
+  for (int f = (int)E::eFirstInt; f < (int)E::eLastInt; f++, i++)
+  {
+    if ((int)LogDataSchema<E>::c_fields[i].m_field != f)
+      return false;
+  }
+  for (int f = (int)E::eFirstDouble; f < (int)E::eLastDouble; f++, i++)
+  {
+    if ((int)LogDataSchema<E>::c_fields[i].m_field != f)
+      return false;
+  }
+
+  return true;
+}
+
 template <typename E>
 class LogDataT
 {
 public:
-  LogDataT(const std::vector<std::string>& headerNames, bool bAddToDashboard, const std::string& dashboardPrefix)
-    : m_headerNames(headerNames)
-    , m_bAddToDashboard(bAddToDashboard)
-    , m_dashboardPrefix(dashboardPrefix)
-  {
-    ShuffleboardTab& tab = Shuffleboard::GetTab("LogShadow");
+  static constexpr size_t c_numInts = (int)E::eLastInt - (int)E::eFirstInt;
+  static constexpr size_t c_numDoubles = (int)E::eLastDouble - (int)E::eFirstDouble;
+  static constexpr size_t c_numFields = c_numInts + c_numDoubles;
 
-    int h = 0;
-    if (E::eFirstInt < E::eLastInt)
-    {
-      for (int i = (int)E::eFirstInt; i < (int)E::eLastInt; i++)
-      {
-        m_dataInt.push_back(0);
-        if (m_bAddToDashboard)
-        {
-          std::string header = dashboardPrefix + m_headerNames[h++];
-          m_netTableEntries.push_back(tab.Add(header, 0).GetEntry());
-          m_netTableEntries.back().SetDouble(0.0);
-        }
-      }
-    }
+  static_assert(std::size(LogDataSchema<E>::c_fields) == c_numFields, "LogDataSchema must name every field of the enum");
+  static_assert(LogFieldsInEnumOrder<E>(), "LogDataSchema must list the fields in enum order, ints first");
 
-    for (int i = (int)E::eFirstDouble; i < (int)E::eLastDouble; i++)
+  /// @param sampleRate   Times per second the data is logged, sizes its flight recorder window. 0 for the logger's default rate.
+  LogDataT(bool bAddToDashboard, const std::string& dashboardPrefix, double sampleRate = 0.0)
+    : m_dashboardPrefix(dashboardPrefix)
+    , m_bAddToDashboard(bAddToDashboard)
+    , m_sampleRate(sampleRate)
+  {
+    if (m_bAddToDashboard)
     {
-      m_dataDouble.push_back(0.0);
-      if (m_bAddToDashboard)
+      ShuffleboardTab& tab = Shuffleboard::GetTab("LogShadow");
+      for (size_t i = 0; i < c_numFields; i++)
       {
-        std::string header = dashboardPrefix + m_headerNames[h++];
-        m_netTableEntries.push_back(tab.Add(header, 0).GetEntry());
-        m_netTableEntries.back().SetDouble(0.0);
+        m_netTableEntries[i] = tab.Add(dashboardPrefix + GetFieldName(i), 0).GetEntry();
+        m_netTableEntries[i].SetDouble(0.0);
       }
     }
   }
 
-  int& operator[](int index)
+  int& Int(E index)
   {
-    return m_dataInt[index];
+    assert((int)index >= (int)E::eFirstInt && (int)index < (int)E::eLastInt);
+    return m_dataInt[(int)index - (int)E::eFirstInt];
   }
 
   double& operator[](E index)
   {
+    assert((int)index >= (int)E::eFirstDouble && (int)index < (int)E::eLastDouble);
     return m_dataDouble[(int)index - (int)E::eFirstDouble];
   }
 
-  const std::vector<std::string>& GetHeaderNames() const
+  /// Name of field i, counting the ints first and then the doubles
+  static constexpr const char* GetFieldName(size_t i)
   {
-    return m_headerNames;
+    return LogDataSchema<E>::c_fields[i].m_name;
   }
 
-  const std::vector<int>& GetInts() const
+  const std::array<int, c_numInts>& GetInts() const
   {
     return m_dataInt;
   }
 
-  const std::vector<double>& GetDoubles() const
+  const std::array<double, c_numDoubles>& GetDoubles() const
   {
     return m_dataDouble;
   }
 
-  void UpdateDashboard()
+  /// Hands the dashboard entries to the publisher, which then reads the fields directly. Only the first call does anything.
+  void AddToPublisher(TelemetryPublisher& publisher)
   {
-    if (m_bAddToDashboard)
+    if (!m_bAddToDashboard || m_bOnPublisher)
     {
-      int h = 0;
-      if (E::eFirstInt < E::eLastInt)
-      {
-        for (int i = (int)E::eFirstInt; i < (int)E::eLastInt; i++)
-        {
-          m_netTableEntries[h++].SetDouble((double)m_dataInt[i]);
-        }
-      }
+      return;
+    }
+    m_bOnPublisher = true;
 
-      for (int i = (int)E::eFirstDouble; i < (int)E::eLastDouble; i++)
-      {
-        m_netTableEntries[h++].SetDouble(m_dataDouble[i - (int)E::eFirstDouble]);
-      }
+    size_t h = 0;
+    for (int& value : m_dataInt)
+    {
+      const LogField<E>& field = LogDataSchema<E>::c_fields[h];
+      publisher.AddField(m_netTableEntries[h++], &value, field.m_deadband, field.m_period);
+    }
+
+    for (double& value : m_dataDouble)
+    {
+      const LogField<E>& field = LogDataSchema<E>::c_fields[h];
+      publisher.AddField(m_netTableEntries[h++], &value, field.m_deadband, field.m_period);
     }
   }
 
-  bool LoggedHeader() const { return m_bLoggedHeader; }
-  void SetHeaderLogged() { m_bLoggedHeader = true; }
+  /// The CSV header goes out once per log segment, the logger hands in its current segment number
+  bool LoggedHeader(unsigned segment) const { return m_headerSegment == segment; }
+  void SetHeaderLogged(unsigned segment) { m_headerSegment = segment; }
+
+  /// Stream id in the logger's binary sink, -1 until registered
+  int GetStreamId() const { return m_streamId; }
+  void SetStreamId(int streamId) { m_streamId = streamId; }
+
+  double GetSampleRate() const { return m_sampleRate; }
 
 private:
-  std::vector<std::string> m_headerNames;
   std::string m_dashboardPrefix;
-  std::vector<int> m_dataInt;
-  std::vector<double> m_dataDouble;
+  std::array<int, c_numInts> m_dataInt{};
+  std::array<double, c_numDoubles> m_dataDouble{};
   bool m_bAddToDashboard;
-  bool m_bLoggedHeader = false;
-  std::vector<nt::NetworkTableEntry> m_netTableEntries;
+  double m_sampleRate;
+  bool m_bOnPublisher = false;
+  unsigned m_headerSegment = 0;
+  int m_streamId = -1;
+  std::array<nt::NetworkTableEntry, c_numFields> m_netTableEntries;
+};
+
+/// Fixed size record handed from the robot thread to the background log writer
+struct LogRecord
+{
+    static constexpr size_t c_msgSize = 448;
+
+    enum EType
+    {
+          eMessage
+        , eData         //!< Raw LogDataT ints and doubles for the binary sink
+        , eOpen
+        , eClose
+        , eTrigger      //!< Dump the flight recorder, m_msg holds the reason
+        , ePart         //!< c_msgSize chars, not terminated, of a message continued by the next record
+    };
+
+    EType m_type;
+    ELogLevel m_level;
+    int m_siteId;
+    int m_streamId;
+    double m_timestamp;
+    union
+    {
+        char m_msg[c_msgSize];
+        unsigned char m_payload[c_msgSize];
+    };
+};
+
+/// A log call site, interned once so log lines only carry its id
+struct LogSite
+{
+    std::string m_func;
+    int m_line = 0;
+    std::string m_instance;     //!< Distinguishes objects sharing the same code, e.g. the swerve module name
+    std::string m_name;         //!< func or func[instance]
+};
+
+/// Layout of one LogDataT stream in the binary sink
+struct LogStreamSchema
+{
+    std::string m_name;
+    std::vector<std::string> m_fieldNames;
+    int m_numInts = 0;
+    int m_numDoubles = 0;
+    bool m_bSummary = false;    //!< Already reduced (LogStatsT): every record is logged, none kept by the flight recorder
+    double m_sampleRate = 0.0;  //!< Records per second, 0 for the flight recorder's default
 };
 
 class Logger
 {
-    FILE* m_fd = nullptr;
+    LogStorage m_storage;           //!< Owned by the writer thread in async mode
     Timer m_timer;
     bool m_console_echo = false;
-    string m_path;
+
+    // Asynchronous mode: logMsg only copies a record into the ring, the writer thread does the file I/O
+    static constexpr size_t c_ringSize = 1024;
+    using LogRing = SpscRingBuffer<LogRecord, c_ringSize>;
+    bool m_bAsync = false;
+    std::unique_ptr<LogRing> m_ring;
+    std::thread m_writerThread;
+    std::atomic<bool> m_bRunWriter{false};
+    std::atomic<uint32_t> m_droppedRecords{0};  //!< Records lost because the ring was full
+    uint32_t m_reportedDrops = 0;               //!< Writer thread only
+    std::atomic<uint32_t> m_splitRecords{0};    //!< Messages too long for one record, sent as several
+    std::string m_pendingMsg;                   //!< Writer thread only, ePart text waiting for the rest of its message
+    int m_pendingSiteId = 0;
+    double m_pendingTimestamp = 0.0;
+
+    // Binary sink for LogDataT streams, written next to the CSV file
+    static constexpr int c_maxStreams = 16;
+    bool m_bBinaryData = false;
+    std::array<LogStreamSchema, c_maxStreams> m_streams;
+    std::atomic<int> m_numStreams{0};                   //!< Published after the schema is filled in
+    std::array<bool, c_maxStreams> m_bSchemaWritten{};  //!< Per file, owned by whoever writes the file
+
+    // Full rate history of the binary streams, the log itself only gets every m_dataDecimation'th sample
+    FlightRecorder m_flightRecorder;                    //!< Owned by whoever writes the files
+    double m_defaultSampleRate = 0.0;                   //!< For streams registered without a rate
+    int m_dataDecimation = 1;
+    std::array<unsigned, c_maxStreams> m_decimationCount{};
+    double m_triggerHoldoff = 0.0;
+    double m_lastTrigger = -1.0e9;                      //!< Robot thread only
+
+    // Dashboard copies of the LogDataT fields, robot thread only
+    static constexpr size_t c_dashboardEntriesPerLoop = 20;
+    TelemetryPublisher m_telemetry{c_dashboardEntriesPerLoop};
+
+    // Bumped on every open/close request so each new segment gets its CSV headers
+    unsigned m_logSegment = 1;
+
+    // Log site registry. Sites are added under m_sitesMutex from any thread and published through
+    // m_numSites, a published site is never changed. Each file gets the id to name table, written
+    // just before the first line that needs it.
+    static constexpr int c_maxSites = 128;
+    std::array<LogSite, c_maxSites> m_sites;
+    std::atomic<int> m_numSites{0};
+    std::mutex m_sitesMutex;
+    int m_sitesWritten = 0;             //!< Per file, owned by whoever writes the file
+    int m_loggerSiteId = 0;             //!< Site for the logger's own messages
+
+    // Site ids of the func/line overloads, open addressed on the address of func and the line.
+    // A slot is claimed under m_sitesMutex and published by storing m_func last, lookups take no lock.
+    struct SiteSlot
+    {
+        std::atomic<const char*> m_func{nullptr};
+        int m_line = 0;
+        int m_siteId = 0;
+    };
+    static constexpr size_t c_siteSlots = 2 * c_maxSites;     //!< Power of two, half full at most
+    std::array<SiteSlot, c_siteSlots> m_siteSlots;
 
   public:
-    Logger(const char *path, bool console_echo);
+    /// @param storage      Log directory, staging and disk budget settings
+    /// @param console_echo Also print every line to stdout
+    /// @param async        Hand records to a background writer thread instead of writing on the caller's thread
+    /// @param binaryData   Write LogDataT streams to a binary .bin file instead of formatting them into the CSV
+    Logger(const LogStorage::Config& storage, bool console_echo, bool async = false, bool binaryData = false);
     ~Logger();
 
-    void openLog();
+    /// Starts a new log segment, tag goes into the file name (e.g. the robot mode)
+    void openLog(const char* tag);
     void closeLog();
 
+    /// Number of records dropped so far because the writer thread fell behind (async mode only)
+    uint32_t GetDroppedRecords() const { return m_droppedRecords.load(std::memory_order_relaxed); }
+
+    /// Number of messages so far that did not fit one ring record and went through as several (async mode only)
+    uint32_t GetSplitRecords() const { return m_splitRecords.load(std::memory_order_relaxed); }
+
+    /// Keeps windowSeconds of every binary stream at full rate in RAM and logs only every decimation'th sample.
+    /// Each stream's window holds windowSeconds at the rate its LogDataT was given, or at defaultSampleRate.
+    /// Call before anything is logged.
+    void SetFlightRecorder(double windowSeconds, double defaultSampleRate, int decimation);
+
+    /// Writes the flight recorder window to a fault file. Repeated triggers within one window are ignored.
+    void TriggerFlightRecorder(const char* reason);
+
+    /// Sends the LogDataT fields that are due to the dashboard. Call once per robot loop.
+    void PublishDashboard();
+
+    /// Interns a log call site. Hot paths register once and log by id; instance tells apart
+    /// objects that share the same code. Any thread.
+    int RegisterSite(const char* func, const int line, const std::string& instance = "");
+
+    void logMsg(ELogLevel level, int siteId, const char* msg, const char* msg2 = nullptr);
+
+    /// Convenience overload, looks the site up by the address of func (pass __func__) and line
     void logMsg(ELogLevel level, const char* func, const int line, const char* msg, const char* msg2 = nullptr);
     void logData(const char* func, const int line, const vector<double*>& data);
     void logData(const char* func, const int line, const vector<int*>& data);
     void logData(const char* func, const int line, const vector<int*>& dataInt, const vector<double*>& dataDouble);
 
     template <typename E>
-    void logHeader(const char* func, const int line, const LogDataT<E>& data)
+    void logHeader(int siteId, const LogDataT<E>& data)
     {
       std::string out;
-      auto& header = data.GetHeaderNames();
-      out.reserve(header.size() * 20);
-      for (auto& hn : header)
+      out.reserve(LogDataT<E>::c_numFields * 20);
+      for (size_t i = 0; i < LogDataT<E>::c_numFields; i++)
       {
-        out += hn + ',';
+        out += LogDataT<E>::GetFieldName(i);
+        out += ',';
       }
       out.erase(out.size() - 1, 1);           // Remove the trailing comma
-      logMsg(eInfo, func, line, out.c_str());
+      logMsg(eInfo, siteId, out.c_str());
     }
-    
+
     template <typename E>
     void logData(const char* func, const int line, LogDataT<E>& data)
     {
-      m_formattedIntData.clear();
-      m_formattedDoubleData.clear();
+      logData(findSite(func, line), data);
+    }
 
-      auto& ints = data.GetInts();
-      if (!ints.empty())
+    template <typename E>
+    void logData(int siteId, LogDataT<E>& data)
+    {
+      if (m_bBinaryData)
       {
-        formatData(ints);
+        if (data.GetStreamId() < 0)
+        {
+          std::vector<std::string> fieldNames;
+          for (size_t i = 0; i < LogDataT<E>::c_numFields; i++)
+          {
+            fieldNames.emplace_back(LogDataT<E>::GetFieldName(i));
+          }
+          data.SetStreamId(registerStream(m_sites[siteId].m_name.c_str(), fieldNames, LogDataT<E>::c_numInts, LogDataT<E>::c_numDoubles, data.GetSampleRate()));
+        }
+
+        if (data.GetStreamId() >= 0)
+        {
+          logBinary(data.GetStreamId(), data.GetInts().data(), data.GetDoubles().data());
+          updateDashboard(data);
+          return;
+        }
       }
 
+      auto& ints = data.GetInts();
       auto& doubles = data.GetDoubles();
-      if (!doubles.empty())
+      char formattedInts[c_formatBufferSize];
+      char formattedDoubles[c_formatBufferSize];
+      if (!formatData(formattedInts, ints) || !formatData(formattedDoubles, doubles))
       {
-        formatData(doubles);
+        logMsg(eError, siteId, "Too many data fields to format");
+        return;
       }
 
-      if (!data.LoggedHeader())
+      if (!data.LoggedHeader(m_logSegment))
       {
-          data.SetHeaderLogged();
-          logHeader(func, line, data);
+          data.SetHeaderLogged(m_logSegment);
+          logHeader(siteId, data);
       }
 
       if (!ints.empty() && !doubles.empty())
       {
-        logMsg(eInfo, func, line, m_formattedIntData.c_str(), m_formattedDoubleData.c_str());
+        logMsg(eInfo, siteId, formattedInts, formattedDoubles);
       }
       else if (!ints.empty())
       {
-        logMsg(eInfo, func, line, m_formattedIntData.c_str());
+        logMsg(eInfo, siteId, formattedInts);
       }
       else
       {
-        logMsg(eInfo, func, line, m_formattedDoubleData.c_str());
+        logMsg(eInfo, siteId, formattedDoubles);
+      }
+
+      updateDashboard(data);
+    }
+
+    /// Aggregation stage: adds data to stats and, each time a window closes, logs one summary
+    /// per double field instead of the raw samples. In binary mode the summaries go to a
+    /// "<site> stats" stream, which is not decimated or kept by the flight recorder.
+    template <typename E>
+    void logStats(int siteId, LogDataT<E>& data, LogStatsT<E>& stats)
+    {
+      updateDashboard(data);
+      if (!stats.Add(data, m_timer.GetFPGATimestamp()))
+      {
+        return;
+      }
+
+      if (m_bBinaryData && stats.GetStreamId() < 0)
+      {
+        std::vector<std::string> fieldNames = { "field", "count" };
+        for (const char* name : LogStatsSummary::c_valueNames)
+        {
+          fieldNames.emplace_back(name);
+        }
+        std::string name = m_sites[siteId].m_name + " stats";
+        stats.SetStreamId(registerStream(name.c_str(), fieldNames, 2, LogStatsSummary::eNumValues, 0.0, true));
+      }
+
+      if (!stats.LoggedHeader(m_logSegment) && stats.GetStreamId() < 0)
+      {
+        stats.SetHeaderLogged(m_logSegment);
+        std::string header = "field,count";
+        for (const char* name : LogStatsSummary::c_valueNames)
+        {
+          header += ',';
+          header += name;
+        }
+        logMsg(eInfo, siteId, header.c_str());
       }
-      
-      // Only update the dashboard once a second
-      if (m_timer.HasPeriodPassed(1.0))
+
+      for (size_t i = 0; i < LogStatsT<E>::c_numFields; i++)
       {
-        data.UpdateDashboard();
+        const LogStatsSummary& summary = stats.GetSummary(i);
+        if (stats.GetStreamId() >= 0)
+        {
+          logBinary(stats.GetStreamId(), summary.m_ints.data(), summary.m_values.data());
+          continue;
+        }
+
+        char formatted[c_formatBufferSize];
+        char* out = NumberFormat::FormatInt(formatted, summary.m_ints[1]);
+        *out++ = ',';
+        formatData(out, summary.m_values);
+        logMsg(eInfo, siteId, LogStatsT<E>::GetFieldName(i), formatted);
       }
     }
 
   protected:
-    void formatData(const vector<double*>& data);
-    void formatData(const vector<double>& data);
-    void formatData(const vector<int*>& data);
-    void formatData(const vector<int>& data);
-    string m_formattedIntData;
-    string m_formattedDoubleData;
+    template <typename E>
+    void updateDashboard(LogDataT<E>& data)
+    {
+      // The publisher reads the fields itself from now on
+      data.AddToPublisher(m_telemetry);
+    }
+
+    int registerStream(const char* name, const std::vector<std::string>& fieldNames, size_t numInts, size_t numDoubles, double sampleRate, bool bSummary = false);
+    void logBinary(int streamId, const int* ints, const double* doubles);
+    void storeData(int streamId, double timestamp, const void* ints, const void* doubles);
+    void writeData(int streamId, double timestamp, const void* ints, const void* doubles);
+    void dumpFlightRecorder(const char* reason, double timestamp);
+    void writeSchema(LogFile& file, int streamId);
+    void writeBinaryRecord(LogFile& file, int streamId, double timestamp, const void* ints, const void* doubles);
+
+    void openFile(const char* tag);
+    void closeFile();
+    void writeLine(double timestamp, ELogLevel level, int siteId, const char* msg, const char* msg2);
+    void writeNewSites();
+    int findSite(const char* func, const int line);
+    int registerSiteLocked(const char* func, const int line, const std::string& instance);
+
+    void pushRecord(LogRecord::EType type, double timestamp, ELogLevel level, int siteId, const char* msg, const char* msg2);
+    void writerLoop();
+    void drainRing();
+    const char* assembleMessage(LogRecord* rec);
+
+    // Formatted data lines are built in stack buffers of this size, enough for c_maxDataFields values
+    static constexpr size_t c_maxDataFields = 32;
+    static constexpr size_t c_formatBufferSize = c_maxDataFields * (NumberFormat::c_maxChars + 1) + 1;
+
+    static double dataValue(double value) { return value; }
+    static double dataValue(const double* value) { return *value; }
+    static int dataValue(int value) { return value; }
+    static int dataValue(const int* value) { return *value; }
+
+    static char* formatValue(char* out, double value) { return NumberFormat::FormatFixed3(out, value); }
+    static char* formatValue(char* out, int value) { return NumberFormat::FormatInt(out, value, 6); }
+
+    /// Writes the values comma separated and null terminated into out, which holds c_formatBufferSize chars.
+    /// Returns false without writing anything if there are more than c_maxDataFields values.
+    template <typename Container>
+    static bool formatData(char* out, const Container& data)
+    {
+      if (data.size() > c_maxDataFields)
+      {
+        return false;
+      }
+
+      for (size_t i = 0; i < data.size(); i++)
+      {
+        if (i > 0)
+        {
+          *out++ = ',';
+        }
+        out = formatValue(out, dataValue(data[i]));
+      }
+      *out = '\0';
+
+      return true;
+    }
 };
 
 #endif /* SRC_Logger_H_ */
@@ -0,0 +1,124 @@
+/*
+    Allocation free number formatting for the logger
+
+    Writes into a caller provided buffer and returns a pointer one past the last
+    character written (no terminator). The buffer must hold c_maxDoubleChars or
+    c_maxIntChars characters, the output is never truncated.
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace NumberFormat
+{
+    /// Below this magnitude the fixed point kernel matches printf, above it printf does the work
+    constexpr double c_kernelLimit = 1.0e9;
+    /// Values at or above this magnitude are written in exponent form
+    constexpr double c_fixedLimit = 1.0e15;
+
+    constexpr size_t c_maxDoubleChars = 24;     //!< "-1.0000000000000000e+308"
+    constexpr size_t c_maxIntChars = 11;        //!< "-2147483648"
+    constexpr size_t c_maxChars = c_maxDoubleChars > c_maxIntChars ? c_maxDoubleChars : c_maxIntChars;
+
+    inline char* FormatUnsigned(char* out, uint64_t value)
+    {
+        char digits[20];
+        int n = 0;
+        do
+        {
+            digits[n++] = '0' + value % 10;
+            value /= 10;
+        } while (value != 0);
+
+        while (n > 0)
+        {
+            *out++ = digits[--n];
+        }
+
+        return out;
+    }
+
+    /// Same text as printf("%.3f") for magnitudes below c_fixedLimit, "%.16e" above
+    inline char* FormatFixed3(char* out, double value)
+    {
+        if (std::isnan(value))
+        {
+            memcpy(out, "nan", 3);
+            return out + 3;
+        }
+
+        if (std::signbit(value))
+        {
+            *out++ = '-';
+            value = -value;
+        }
+
+        if (std::isinf(value))
+        {
+            memcpy(out, "inf", 3);
+            return out + 3;
+        }
+
+        if (value >= c_kernelLimit)
+        {
+            return out + sprintf(out, value >= c_fixedLimit ? "%.16e" : "%.3f", value);
+        }
+
+        // value = mantissa * 2^-shift exactly; scale by 1000 in integers and round half to even like printf
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        int biasedExp = static_cast<int>(bits >> 52);
+        uint64_t scaled = 0;
+        if (biasedExp != 0)     // Subnormals round to zero
+        {
+            uint64_t product = ((bits & ((1ull << 52) - 1)) | (1ull << 52)) * 1000;    // < 2^63
+            int shift = 1075 - biasedExp;                                               // > 22 below c_kernelLimit
+            if (shift < 64)
+            {
+                scaled = product >> shift;
+                uint64_t rem = product & ((1ull << shift) - 1);
+                uint64_t half = 1ull << (shift - 1);
+                if (rem > half || (rem == half && (scaled & 1) != 0))
+                {
+                    scaled++;
+                }
+            }
+        }
+        unsigned frac = static_cast<unsigned>(scaled % 1000);
+        out = FormatUnsigned(out, scaled / 1000);
+        out[0] = '.';
+        out[1] = '0' + frac / 100;
+        out[2] = '0' + frac / 10 % 10;
+        out[3] = '0' + frac % 10;
+
+        return out + 4;
+    }
+
+    /// Same text as printf("%*d", width, value), width at most c_maxIntChars
+    inline char* FormatInt(char* out, int value, int width = 0)
+    {
+        char digits[c_maxIntChars];
+        char* end = digits;
+        // Negate in unsigned so INT_MIN works
+        uint32_t magnitude = static_cast<uint32_t>(value);
+        if (value < 0)
+        {
+            *end++ = '-';
+            magnitude = 0u - magnitude;
+        }
+        end = FormatUnsigned(end, magnitude);
+
+        int len = end - digits;
+        for (; width > len; width--)
+        {
+            *out++ = ' ';
+        }
+        memcpy(out, digits, len);
+
+        return out + len;
+    }
+}
@@ -0,0 +1,168 @@
+/*
+    Timestamped history of the odometry
+
+    A fixed ring of the newest Capacity odometry updates, each with the pose, the gyro heading
+    and the module states it was made from. Sample interpolates the record at any time the
+    ring still covers with a binary search, O(log n). Rebase moves the history onto a pose
+    measured in the past, e.g. from a camera image taken a few loops ago: every record from
+    the measurement on keeps its motion relative to the pose at the measurement time, so the
+    odometry since then is replayed on top of the measurement.
+
+    Nothing allocates; a Push is a copy of one record.
+*/
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+#include "AngleMath.h"
+
+template <size_t NumModules, size_t Capacity>
+class PoseHistory
+{
+    static_assert(Capacity >= 2, "PoseHistory needs room for two records to interpolate");
+
+public:
+    struct ModuleRecord
+    {
+        double m_speed;         //!< Meters per second
+        double m_angle;         //!< Radians
+    };
+
+    struct Record
+    {
+        double m_timestamp;     //!< Seconds
+        double m_x;             //!< Meters, field frame
+        double m_y;
+        double m_rotation;      //!< Radians, the odometry's heading
+        double m_heading;       //!< Radians, the gyro reading the update used
+        std::array<ModuleRecord, NumModules> m_modules;
+    };
+
+    /// Adds the newest record. Records must come in time order, one that does not is dropped.
+    void Push(const Record& record)
+    {
+        if (m_size > 0 && record.m_timestamp <= At(m_size - 1).m_timestamp)
+        {
+            return;
+        }
+
+        m_records[(m_first + m_size) % Capacity] = record;
+        if (m_size < Capacity)
+        {
+            m_size++;
+        }
+        else
+        {
+            m_first = (m_first + 1) % Capacity;
+        }
+    }
+
+    void Clear()
+    {
+        m_first = 0;
+        m_size = 0;
+    }
+
+    size_t Size() const { return m_size; }
+    const Record& Oldest() const { return At(0); }
+    const Record& Newest() const { return At(m_size - 1); }
+
+    /// Record at timestamp, interpolated between the two around it. Past the newest record
+    /// the newest is returned. False if the history is empty or starts after timestamp.
+    bool Sample(double timestamp, Record& out) const
+    {
+        if (m_size == 0 || timestamp < Oldest().m_timestamp)
+        {
+            return false;
+        }
+
+        if (timestamp >= Newest().m_timestamp)
+        {
+            out = Newest();
+            return true;
+        }
+
+        size_t after = FindAfter(timestamp);
+        const Record& r0 = At(after - 1);
+        const Record& r1 = At(after);
+        double t = (timestamp - r0.m_timestamp) / (r1.m_timestamp - r0.m_timestamp);
+
+        out.m_timestamp = timestamp;
+        out.m_x = Lerp(r0.m_x, r1.m_x, t);
+        out.m_y = Lerp(r0.m_y, r1.m_y, t);
+        out.m_rotation = LerpAngle(r0.m_rotation, r1.m_rotation, t);
+        out.m_heading = LerpAngle(r0.m_heading, r1.m_heading, t);
+        for (size_t i = 0; i < NumModules; i++)
+        {
+            out.m_modules[i].m_speed = Lerp(r0.m_modules[i].m_speed, r1.m_modules[i].m_speed, t);
+            out.m_modules[i].m_angle = LerpAngle(r0.m_modules[i].m_angle, r1.m_modules[i].m_angle, t);
+        }
+
+        return true;
+    }
+
+    /// Moves the records from timestamp on so the pose at timestamp becomes (x, y, rotation),
+    /// keeping each record's motion relative to it. False, and nothing changes, if the history
+    /// does not reach back to timestamp. Newest() is then the corrected current pose.
+    bool Rebase(double timestamp, double x, double y, double rotation)
+    {
+        Record then;
+        if (!Sample(timestamp, then))
+        {
+            return false;
+        }
+
+        double delta = AngleMath::NegPiToPi(rotation - then.m_rotation);
+        double cosDelta = cos(delta);
+        double sinDelta = sin(delta);
+
+        // A measurement newer than the history was sampled as the newest record, which is
+        // then the one to move
+        for (size_t i = m_size; i-- > 0 && (i == m_size - 1 || At(i).m_timestamp >= timestamp); )
+        {
+            Record& record = At(i);
+            double dx = record.m_x - then.m_x;
+            double dy = record.m_y - then.m_y;
+            record.m_x = x + cosDelta * dx - sinDelta * dy;
+            record.m_y = y + sinDelta * dx + cosDelta * dy;
+            record.m_rotation += delta;
+        }
+
+        return true;
+    }
+
+private:
+    Record& At(size_t i) { return m_records[(m_first + i) % Capacity]; }
+    const Record& At(size_t i) const { return m_records[(m_first + i) % Capacity]; }
+
+    /// Index of the first record after timestamp, which must be inside the history
+    size_t FindAfter(double timestamp) const
+    {
+        size_t lo = 0;
+        size_t hi = m_size - 1;
+        while (lo < hi)
+        {
+            size_t mid = (lo + hi) / 2;
+            if (At(mid).m_timestamp <= timestamp)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+
+        return lo;
+    }
+
+    static double Lerp(double a, double b, double t) { return a + (b - a) * t; }
+    static double LerpAngle(double a, double b, double t) { return a + AngleMath::NegPiToPi(b - a) * t; }
+
+    std::array<Record, Capacity> m_records;
+    size_t m_first = 0;         //!< Index of the oldest record
+    size_t m_size = 0;
+};
@@ -9,6 +9,7 @@
 
 #include <frc/TimedRobot.h>
 #include <frc2/command/Command.h>
+#include <networktables/NetworkTableEntry.h>
 
 #include "Logger.h"
 #include "RobotContainer.h"
@@ -36,4 +37,7 @@ private:
     frc2::Command *m_autonomousCommand = nullptr;
 
     RobotContainer m_container;
+
+    nt::NetworkTableEntry m_nteDumpFlightRecorder;
+    nt::NetworkTableEntry m_nteWriteTrace;
 };
@@ -16,6 +16,7 @@
 #include <frc2/command/PIDCommand.h>
 #include <frc2/command/ParallelRaceGroup.h>
 #include <frc2/command/RunCommand.h>
+#include <frc/trajectory/Trajectory.h>
 
 #include "Constants.h"
 #include "Logger.h"
@@ -70,4 +71,11 @@ private:
 
 
     void ConfigureButtonBindings();
+
+    /// Makes the autonomous trajectories at construction, from the cache file when it has them,
+    /// so GetAutonomousCommand does no generation on the way into autonomous
+    void LoadTrajectories();
+
+    frc::Trajectory m_exampleTrajectory;
+    frc::Trajectory m_exampleTrajectory2;
 };
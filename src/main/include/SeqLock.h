@@ -0,0 +1,73 @@
+/*
+    Sequence lock
+    Publishes a small value from one writer thread to any number of readers without a mutex
+
+    The writer makes the sequence odd, stores the value and makes it even again. A reader
+    copies the value between two reads of the sequence and retries if a write was in progress
+    or happened meanwhile, so it never waits on the writer being scheduled, only on a store of
+    a few words finishing. The value is kept as relaxed atomic words so the overlapping copy
+    is not a data race. Writes from more than one thread must be serialized by the caller.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+template <typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock value must be trivially copyable");
+    static constexpr size_t c_numWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+public:
+    explicit SeqLock(const T& value = T())
+    {
+        Write(value);
+    }
+
+    /// Writer side
+    void Write(const T& value)
+    {
+        std::array<uint64_t, c_numWords> words{};
+        memcpy(words.data(), &value, sizeof(T));
+
+        uint32_t seq = m_seq.load(std::memory_order_relaxed);
+        m_seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < c_numWords; i++)
+        {
+            m_words[i].store(words[i], std::memory_order_relaxed);
+        }
+        m_seq.store(seq + 2, std::memory_order_release);
+    }
+
+    /// Reader side, any thread: the last value written, never a mix of two writes
+    T Read() const
+    {
+        std::array<uint64_t, c_numWords> words;
+        uint32_t before;
+        uint32_t after;
+        do
+        {
+            before = m_seq.load(std::memory_order_acquire);
+            for (size_t i = 0; i < c_numWords; i++)
+            {
+                words[i] = m_words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = m_seq.load(std::memory_order_relaxed);
+        } while ((before & 1) != 0 || before != after);
+
+        T value;
+        memcpy(&value, words.data(), sizeof(T));
+        return value;
+    }
+
+private:
+    std::atomic<uint32_t> m_seq{0};
+    std::array<std::atomic<uint64_t>, c_numWords> m_words{};
+};
@@ -0,0 +1,131 @@
+/*
+    CAN traffic of one Spark MAX
+
+    Sets the periodic status frame rates, drops setpoints that repeat the last one sent
+    (within a tolerance, with a keep alive resend) and estimates the share of the bus the
+    device uses. Motor is a MotorInterface and Encoder the EncoderInterface of its integrated
+    encoder, so the same accounting runs against simulated hardware. Setpoints that do go out,
+    and encoder position writes, are posted to the device's ActuatorMailbox, which sends them
+    at once or leaves them for an ActuatorWorker thread.
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "ActuatorMailbox.h"
+#include "hardware/HardwareInterfaces.h"
+
+struct SparkMaxTrafficConfig
+{
+    double m_tolerance = 0.0;       //!< Setpoint change that is worth a frame
+    double m_keepAlive = 0.1;       //!< Resend an unchanged setpoint after this long, seconds
+    int m_status0PeriodMs = 10;     //!< Applied output, faults
+    int m_status1PeriodMs = 20;     //!< Velocity, current, temperature, voltage
+    int m_status2PeriodMs = 20;     //!< Position
+};
+
+template <typename Motor, typename Encoder>
+class SparkMaxTraffic
+{
+public:
+    using Config = SparkMaxTrafficConfig;
+
+    /// Configures the status frame periods
+    SparkMaxTraffic(Motor& motor, Encoder& encoder, const Config& config)
+        : m_motor(motor)
+        , m_config(config)
+        , m_mailbox(motor, encoder)
+    {
+        m_motor.SetStatusFramePeriods(m_config.m_status0PeriodMs, m_config.m_status1PeriodMs, m_config.m_status2PeriodMs);
+
+        m_statusFramesPerSec = FramesPerSec(m_config.m_status0PeriodMs)
+                             + FramesPerSec(m_config.m_status1PeriodMs)
+                             + FramesPerSec(m_config.m_status2PeriodMs);
+    }
+
+    /// Sends the reference unless it is within tolerance of the last one sent with the same
+    /// control mode and the keep alive has not expired. Returns true if a frame was sent.
+    /// @param now  Current time in seconds
+    bool SetReference(double value, EMotorControl mode, double now)
+    {
+        if (m_bHaveSetpoint
+         && mode == m_lastMode
+         && fabs(value - m_lastValue) <= m_config.m_tolerance
+         && now - m_lastSent < m_config.m_keepAlive)
+        {
+            m_suppressed++;
+            return false;
+        }
+
+        m_mailbox.Post(value, mode);
+        m_bHaveSetpoint = true;
+        m_lastValue = value;
+        m_lastMode = mode;
+        m_lastSent = now;
+        m_sent++;
+        m_windowSent++;
+
+        return true;
+    }
+
+    /// Moves the integrated encoder's position to position. Always sent, and ahead of any later setpoint.
+    void SetEncoderPosition(double position)
+    {
+        m_mailbox.PostEncoderPosition(position);
+        m_windowSent++;
+    }
+
+    /// Estimated share of a 1 Mbit/s bus used by the device's status and setpoint frames,
+    /// 0 to 1, updated about once a second
+    double GetBusUtilization(double now)
+    {
+        if (m_windowStart < 0.0)
+        {
+            m_windowStart = now;
+        }
+        else if (now - m_windowStart >= c_utilizationWindow)
+        {
+            double framesPerSec = m_statusFramesPerSec + m_windowSent / (now - m_windowStart);
+            m_utilization = framesPerSec * c_bitsPerFrame / c_busBitsPerSec;
+            m_windowStart = now;
+            m_windowSent = 0;
+        }
+
+        return m_utilization;
+    }
+
+    ActuatorMailbox<Motor, Encoder>& GetMailbox() { return m_mailbox; }
+
+    uint32_t GetSentSetpoints() const { return m_sent; }
+    uint32_t GetSuppressedSetpoints() const { return m_suppressed; }
+
+private:
+    // Extended frame with 8 data bytes is 131 bits, plus typical bit stuffing
+    static constexpr double c_bitsPerFrame = 144.0;
+    static constexpr double c_busBitsPerSec = 1.0e6;
+    static constexpr double c_utilizationWindow = 1.0;
+
+    static double FramesPerSec(int periodMs)
+    {
+        return periodMs > 0 ? 1000.0 / periodMs : 0.0;
+    }
+
+    Motor& m_motor;
+    Config m_config;
+    ActuatorMailbox<Motor, Encoder> m_mailbox;
+    double m_statusFramesPerSec;
+
+    bool m_bHaveSetpoint = false;
+    double m_lastValue = 0.0;
+    EMotorControl m_lastMode = EMotorControl::eDutyCycle;
+    double m_lastSent = 0.0;
+
+    uint32_t m_sent = 0;
+    uint32_t m_suppressed = 0;
+
+    double m_windowStart = -1.0;
+    uint32_t m_windowSent = 0;
+    double m_utilization = 0.0;
+};
@@ -0,0 +1,79 @@
+/*
+    Single producer / single consumer ring buffer
+    Lock-free hand off of fixed size records from the robot thread to a background thread
+
+    The producer fills a slot in place (BeginPush / CommitPush) and the consumer reads it
+    in place (Front / Pop), so large records are never copied through temporaries.
+    Capacity must be a power of two; one slot is always left empty.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstddef>
+
+template <typename T, size_t N>
+class SpscRingBuffer
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRingBuffer capacity must be a power of two");
+    static constexpr size_t c_mask = N - 1;
+    static constexpr size_t c_cacheLine = 64;
+
+public:
+    /// Producer side: returns the next free slot or nullptr if the buffer is full
+    T* BeginPush()
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (((head + 1) & c_mask) == m_cachedTail)
+        {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (((head + 1) & c_mask) == m_cachedTail)
+            {
+                return nullptr;
+            }
+        }
+
+        return &m_slots[head];
+    }
+
+    /// Producer side: publishes the slot returned by BeginPush
+    void CommitPush()
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        m_head.store((head + 1) & c_mask, std::memory_order_release);
+    }
+
+    /// Consumer side: returns the oldest record or nullptr if the buffer is empty
+    T* Front()
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_cachedHead)
+        {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if (tail == m_cachedHead)
+            {
+                return nullptr;
+            }
+        }
+
+        return &m_slots[tail];
+    }
+
+    /// Consumer side: releases the record returned by Front
+    void Pop()
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        m_tail.store((tail + 1) & c_mask, std::memory_order_release);
+    }
+
+    static constexpr size_t Capacity() { return N - 1; }
+
+private:
+    // Head and tail live on their own cache lines so the two threads do not false share
+    alignas(c_cacheLine) std::atomic<size_t> m_head{0};
+    size_t m_cachedTail = 0;                            //!< Producer's last view of m_tail
+    alignas(c_cacheLine) std::atomic<size_t> m_tail{0};
+    size_t m_cachedHead = 0;                            //!< Consumer's last view of m_head
+    alignas(c_cacheLine) std::array<T, N> m_slots;
+};
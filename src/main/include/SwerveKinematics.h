@@ -0,0 +1,92 @@
+/*
+    Inverse kinematics for a fixed module layout
+
+    Chassis speeds to module states for the modules of DriveConstants::kModuleConfigs, with the
+    wheel speed desaturation of SwerveDriveKinematics::NormalizeWheelSpeeds folded in. The module
+    positions are compile time constants, so each module's velocity is two multiply-adds. The
+    work is laid out one array per quantity so the compiler can vectorize the velocity and
+    desaturation pass; only the angles (atan2 inside Rotation2d) are per module.
+    Gives the same states as ToSwerveModuleStates followed by NormalizeWheelSpeeds.
+*/
+
+#pragma once
+
+#include <frc/geometry/Rotation2d.h>
+#include <frc/kinematics/ChassisSpeeds.h>
+#include <frc/kinematics/SwerveModuleState.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+#include "Constants.h"
+
+template <size_t N>
+class SwerveKinematics
+{
+public:
+    using ModuleStates = std::array<frc::SwerveModuleState, N>;
+
+    constexpr explicit SwerveKinematics(const std::array<DriveConstants::SwerveModuleConfig, N>& configs)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            m_x[i] = configs[i].m_x;
+            m_y[i] = configs[i].m_y;
+        }
+    }
+
+    /// Module states for robot relative chassis speeds, all wheel speeds scaled down together
+    /// so none is above maxSpeed
+    /// @param maxSpeed     Meters per second
+    void ToSwerveModuleStates(const frc::ChassisSpeeds& speeds, double maxSpeed, ModuleStates& states) const
+    {
+        double vx = speeds.vx.to<double>();
+        double vy = speeds.vy.to<double>();
+        double omega = speeds.omega.to<double>();
+
+        std::array<double, N> moduleVx;
+        std::array<double, N> moduleVy;
+        std::array<double, N> speedSquared;
+        double maxSpeedSquared = 0.0;
+        for (size_t i = 0; i < N; i++)
+        {
+            moduleVx[i] = vx - omega * m_y[i];
+            moduleVy[i] = vy + omega * m_x[i];
+            speedSquared[i] = moduleVx[i] * moduleVx[i] + moduleVy[i] * moduleVy[i];
+            maxSpeedSquared = std::max(maxSpeedSquared, speedSquared[i]);
+        }
+
+        double scale = maxSpeedSquared > maxSpeed * maxSpeed ? maxSpeed / sqrt(maxSpeedSquared) : 1.0;
+        for (size_t i = 0; i < N; i++)
+        {
+            states[i].speed = units::meters_per_second_t(sqrt(speedSquared[i]) * scale);
+            states[i].angle = frc::Rotation2d(moduleVx[i], moduleVy[i]);
+        }
+    }
+
+    /// NormalizeWheelSpeeds without the temporaries, for states that did not come from
+    /// ToSwerveModuleStates here
+    static void Desaturate(ModuleStates& states, double maxSpeed)
+    {
+        double realMax = 0.0;
+        for (const frc::SwerveModuleState& state : states)
+        {
+            realMax = std::max(realMax, fabs(state.speed.to<double>()));
+        }
+
+        if (realMax > maxSpeed)
+        {
+            double scale = maxSpeed / realMax;
+            for (frc::SwerveModuleState& state : states)
+            {
+                state.speed *= scale;
+            }
+        }
+    }
+
+private:
+    std::array<double, N> m_x{};      //!< Module positions, meters, +x forward
+    std::array<double, N> m_y{};      //!< +y left
+};
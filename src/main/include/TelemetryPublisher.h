@@ -0,0 +1,51 @@
+/*
+    Telemetry publisher
+    Pushes LogDataT fields to the dashboard under a fixed NetworkTables budget.
+
+    Each field has its own minimum period and deadband: it is sent when it is due and
+    has moved more than the deadband since it was last sent. Publish() walks the fields
+    round robin starting where the previous call ran out of budget, so every stream
+    gets its turn no matter how many are registered.
+*/
+
+#pragma once
+
+#include <networktables/NetworkTableEntry.h>
+
+#include <vector>
+
+class TelemetryPublisher
+{
+public:
+    /// @param entriesPerLoop   Most entries sent by one Publish call
+    explicit TelemetryPublisher(size_t entriesPerLoop);
+
+    /// Adds a field. value must stay valid for the lifetime of the publisher.
+    /// @param deadband Smallest change worth sending
+    /// @param period   Least time between two sends of this field, seconds
+    void AddField(nt::NetworkTableEntry entry, const double* value, double deadband, double period);
+    void AddField(nt::NetworkTableEntry entry, const int* value, double deadband, double period);
+
+    /// Sends the fields that are due, at most the per loop budget. Call once per robot loop.
+    /// @param now  Current time in seconds
+    void Publish(double now);
+
+    size_t GetNumFields() const { return m_fields.size(); }
+
+private:
+    struct Field
+    {
+        nt::NetworkTableEntry m_entry;
+        const double* m_double = nullptr;
+        const int* m_int = nullptr;
+        double m_deadband = 0.0;
+        double m_period = 0.0;
+        double m_lastValue = 0.0;
+        double m_lastTime = 0.0;
+        bool m_bPublished = false;
+    };
+
+    size_t m_entriesPerLoop;
+    std::vector<Field> m_fields;
+    size_t m_next = 0;          //!< Field the next Publish starts at
+};
@@ -0,0 +1,119 @@
+/*
+    Timeline tracing
+    Scoped begin/end markers recorded into a fixed ring of events, written out as a
+    Chrome trace JSON file (chrome://tracing or ui.perfetto.dev) to see where the loop time goes.
+
+    Recording is a clock read, an atomic increment and three relaxed stores, safe from any thread.
+    The ring keeps the newest c_numEvents events. Each event carries the sequence number it was
+    recorded under, so the export can tell a finished event from one still being written or
+    overwritten by another thread and skip it.
+
+        void Foo()
+        {
+            TRACE_SCOPE("Foo");                                 // Whole function
+            double v = TRACE_CALL("GetVelocity", m_encoder.GetVelocity());  // One call
+        }
+*/
+
+#pragma once
+
+#include <time.h>
+
+#include <atomic>
+#include <cstdint>
+
+class TraceBuffer
+{
+public:
+    enum EPhase : uint8_t
+    {
+          eBegin
+        , eEnd
+    };
+
+    /// Sequence number, time and packed id, phase and thread of one event. The fields are
+    /// atomics so WriteChromeTrace can read them while other threads keep recording.
+    struct Event
+    {
+        std::atomic<uint32_t> m_seq{0};         //!< Index the event was recorded under plus one, 0 while written
+        std::atomic<uint32_t> m_info{0};        //!< Id in the low 16 bits, then phase, then thread
+        std::atomic<uint64_t> m_timeNs{0};
+    };
+
+    static constexpr size_t c_numEvents = 1 << 16;      //!< Power of two
+    static constexpr int c_maxNames = 256;
+
+    /// Returns the id to record name under, name must outlive the buffer. Not for hot paths.
+    static int RegisterName(const char* name);
+
+    static void SetEnabled(bool bEnabled) { s_bEnabled.store(bEnabled, std::memory_order_relaxed); }
+
+    static void Record(int id, EPhase phase)
+    {
+        if (!s_bEnabled.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        uint32_t index = s_next.fetch_add(1, std::memory_order_relaxed);
+        Event& event = s_events[index & (c_numEvents - 1)];
+
+        // Seqlock write: invalidate, fill in, then publish under this event's sequence number
+        event.m_seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        event.m_timeNs.store((uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec, std::memory_order_relaxed);
+        event.m_info.store(id | (uint32_t)phase << 16 | (uint32_t)ThreadIndex() << 24, std::memory_order_relaxed);
+        event.m_seq.store(index + 1, std::memory_order_release);
+    }
+
+    /// Writes the recorded events as Chrome trace JSON. Slow, recording is paused meanwhile.
+    /// Safe while other threads record: events they have not finished are left out.
+    static bool WriteChromeTrace(const char* path);
+
+private:
+    static uint8_t ThreadIndex()
+    {
+        static thread_local uint8_t t_thread = s_numThreads.fetch_add(1, std::memory_order_relaxed);
+        return t_thread;
+    }
+
+    static inline std::atomic<bool> s_bEnabled{true};
+    static inline std::atomic<uint32_t> s_next{0};
+    static inline std::atomic<uint8_t> s_numThreads{0};
+    static Event s_events[c_numEvents];
+};
+
+/// Records begin on construction and end on destruction
+class TraceScope
+{
+public:
+    explicit TraceScope(int id)
+        : m_id(id)
+    {
+        TraceBuffer::Record(m_id, TraceBuffer::eBegin);
+    }
+
+    ~TraceScope()
+    {
+        TraceBuffer::Record(m_id, TraceBuffer::eEnd);
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    int m_id;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+/// Traces the rest of the enclosing scope, name must be a string literal
+#define TRACE_SCOPE(name) \
+    static const int TRACE_CONCAT(traceId_, __LINE__) = TraceBuffer::RegisterName(name); \
+    TraceScope TRACE_CONCAT(traceScope_, __LINE__)(TRACE_CONCAT(traceId_, __LINE__))
+
+/// Traces a single expression and yields its value
+#define TRACE_CALL(name, expr) ([&]() { TRACE_SCOPE(name); return expr; }())
@@ -0,0 +1,110 @@
+/*
+    Generated trajectories cached in a binary file
+
+    Get has the arguments of TrajectoryGenerator::GenerateTrajectory. It hashes them into a
+    key and looks the key up in the cache file, which is memory mapped, so a hit reads the
+    states straight from the mapping into the Trajectory. A miss generates the trajectory as
+    before. Save rewrites the file with the trajectories asked for this run if any was
+    generated, so the first boot after a path or config change pays for the generation and
+    the boots after it do not. A stale or damaged file only ever costs a regeneration.
+
+    File layout (native byte order, the roboRIO writes and reads it, 8 byte aligned):
+
+        Header      char[4] magic "TRAJ", uint32 version, uint32 number of trajectories, uint32 0
+        Entries     per trajectory: uint64 key, uint32 index of its first state, uint32 number of states
+        States      per state: double t, velocity, acceleration, x, y, rotation (radians), curvature
+
+    The key covers the waypoints, the config's speeds and direction, and the module positions
+    of DriveConstants::kModuleConfigs, which is what the config's kinematics constraint is
+    built from. Other constraints added to a config are not seen by the key, so bump
+    c_version when adding one.
+*/
+
+#pragma once
+
+#include <frc/geometry/Pose2d.h>
+#include <frc/geometry/Translation2d.h>
+#include <frc/trajectory/Trajectory.h>
+#include <frc/trajectory/TrajectoryConfig.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace TrajectoryFile
+{
+    constexpr char c_magic[4] = { 'T', 'R', 'A', 'J' };
+    constexpr uint32_t c_version = 1;
+
+    struct Header
+    {
+        char m_magic[4];
+        uint32_t m_version;
+        uint32_t m_numTrajectories;
+        uint32_t m_reserved;
+    };
+
+    struct Entry
+    {
+        uint64_t m_key;
+        uint32_t m_firstState;
+        uint32_t m_numStates;
+    };
+
+    struct State
+    {
+        double m_t;
+        double m_velocity;
+        double m_acceleration;
+        double m_x;
+        double m_y;
+        double m_rotation;
+        double m_curvature;
+    };
+}
+
+class TrajectoryCache
+{
+public:
+    /// Maps the cache file at path if there is a valid one
+    explicit TrajectoryCache(const std::string& path);
+    ~TrajectoryCache();
+
+    TrajectoryCache(const TrajectoryCache&) = delete;
+    TrajectoryCache& operator=(const TrajectoryCache&) = delete;
+
+    /// The trajectory TrajectoryGenerator::GenerateTrajectory would make, from the file if it is there
+    frc::Trajectory Get(const frc::Pose2d& start, const std::vector<frc::Translation2d>& interiorWaypoints, const frc::Pose2d& end, const frc::TrajectoryConfig& config);
+
+    /// Rewrites the file if anything was generated. Returns false if that failed.
+    bool Save();
+
+    unsigned GetHits() const { return m_hits; }
+    unsigned GetMisses() const { return m_misses; }
+
+private:
+    static uint64_t Key(const frc::Pose2d& start, const std::vector<frc::Translation2d>& interiorWaypoints, const frc::Pose2d& end, const frc::TrajectoryConfig& config);
+
+    /// Entry for key in the mapped file, nullptr if there is none
+    const TrajectoryFile::Entry* Find(uint64_t key) const;
+
+    /// False for an entry whose states are not all in the file, or have no or out of order times
+    bool IsValid(const TrajectoryFile::Entry& entry) const;
+
+    void Unmap();
+
+    std::string m_path;
+
+    const uint8_t* m_map = nullptr;     //!< Whole file, read only
+    size_t m_mapSize = 0;
+    const TrajectoryFile::Entry* m_entries = nullptr;
+    const TrajectoryFile::State* m_states = nullptr;
+    uint32_t m_numEntries = 0;
+    uint32_t m_numStates = 0;
+
+    std::vector<std::pair<uint64_t, frc::Trajectory>> m_used;     //!< Everything asked for this run, for Save
+    unsigned m_hits = 0;
+    unsigned m_misses = 0;
+};
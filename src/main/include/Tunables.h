@@ -0,0 +1,69 @@
+/*
+    Tunables registry
+    Dashboard tuned parameters without per loop NetworkTables lookups.
+
+    Each parameter is registered once. A NetworkTables listener copies every remote change
+    into a cached value and bumps a generation counter. Control code checks Changed() at a
+    safe point in its loop (one atomic load when nothing changed) and only then reads the
+    cached values with Get().
+*/
+
+#pragma once
+
+#include <networktables/NetworkTableEntry.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// One tuned value, written by the NetworkTables listener thread and read by the robot thread
+class Tunable
+{
+public:
+    double Get() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    friend class Tunables;
+
+    std::atomic<double> m_value{0.0};
+    nt::NetworkTableEntry m_entry;
+};
+
+class Tunables
+{
+public:
+    static Tunables& GetInstance();
+
+    /// Registers a SmartDashboard number and publishes initial.
+    /// Registering a key again returns the same tunable, so modules sharing a key share the value.
+    Tunable& Add(const std::string& key, double initial);
+
+    /// Registers an existing entry, e.g. a Shuffleboard widget, and publishes initial
+    Tunable& Add(nt::NetworkTableEntry entry, double initial);
+
+    /// True once for every batch of changes since the caller's last call, seen is the caller's bookmark
+    bool Changed(unsigned& seen) const
+    {
+        unsigned generation = m_generation.load(std::memory_order_acquire);
+        if (generation == seen)
+        {
+            return false;
+        }
+        seen = generation;
+
+        return true;
+    }
+
+private:
+    Tunables() = default;
+
+    Tunable& Listen(std::unique_ptr<Tunable> tunable, double initial);
+
+    std::mutex m_mutex;                                         //!< Registration only
+    std::map<std::string, Tunable*> m_byKey;
+    std::vector<std::unique_ptr<Tunable>> m_tunables;
+    std::atomic<unsigned> m_generation{0};
+};
@@ -0,0 +1,64 @@
+/*
+    Physics of the simulated drivetrain
+
+    Moves the SimHardware devices: each module's steering (motor torque through the turn
+    reduction against steering inertia and tread scrub) and the chassis (drive motor torque
+    through the drive reduction to a force at each contact patch, rolling resistance,
+    traction limited side load, robot mass and moment of inertia). The drive rotors follow
+    the chassis, so back EMF and current limiting see the real wheel speed.
+
+    Time only advances in Step, which DriveSubsystem::Periodic calls once per loop, so a
+    run is deterministic and goes as fast as the loop can be called.
+*/
+
+#pragma once
+
+#include <array>
+
+#include "Constants.h"
+#include "hardware/HardwareInterfaces.h"
+#include "hardware/SimHardware.h"
+
+class DrivetrainSim
+{
+public:
+    using Modules = std::array<SimModuleHardware*, DriveConstants::kNumSwerveModules>;
+    using Locations = std::array<ModuleLocation, DriveConstants::kNumSwerveModules>;
+
+    /// True chassis state in field coordinates
+    struct State
+    {
+        double m_x = 0.0;           //!< Meters
+        double m_y = 0.0;
+        double m_heading = 0.0;     //!< Radians, counter clockwise positive, unwrapped
+        double m_vx = 0.0;          //!< Meters per second
+        double m_vy = 0.0;
+        double m_omega = 0.0;       //!< Radians per second
+    };
+
+    /// Time only moves in Step, so nothing may sample the devices on a thread of its own
+    static constexpr bool c_bRealTime = false;
+
+    DrivetrainSim(const Modules& modules, const Locations& locations, SimGyro& gyro);
+
+    /// Advances SimConstants::kLoopPeriod using the setpoints sent during the last loop.
+    /// Returns the sim time in seconds, used as the loop timestamp.
+    double Step();
+
+    double GetTime() const { return m_time; }
+    const State& GetState() const { return m_state; }
+
+    /// Places the robot, e.g. at the start of a batch run
+    void SetState(const State& state);
+
+private:
+    void StepPhysics(double dt);
+    void StepSteering(SimModuleHardware& module, double dt);
+
+    Modules m_modules;
+    Locations m_locations;
+    SimGyro& m_gyro;
+
+    State m_state;
+    double m_time = 0.0;
+};
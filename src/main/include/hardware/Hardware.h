@@ -0,0 +1,15 @@
+/*
+    The hardware set the robot program is built with: the real devices on the roboRIO,
+    simulated ones anywhere else. The simulation is left out of the roboRIO build.
+*/
+
+#pragma once
+
+#ifdef __FRC_ROBORIO__
+#include "hardware/RobotHardware.h"
+using Hardware = RobotHardware;
+#else
+#include "hardware/DrivetrainSim.h"
+#include "hardware/SimHardware.h"
+using Hardware = SimHardware;
+#endif
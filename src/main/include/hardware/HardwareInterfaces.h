@@ -0,0 +1,124 @@
+/*
+    Hardware interfaces for the drivetrain
+
+    SwerveModuleT and DriveSubsystemT are templates on a hardware set, so the same control
+    code runs against the real devices on the robot and against simulated ones on a desktop.
+    The interfaces are CRTP bases: an implementation derives from Interface<Impl> and
+    provides the ...Impl methods. Calls resolve at compile time, nothing is virtual.
+
+    A hardware set is a struct with three types:
+
+        struct MyHardware
+        {
+            using Module = ...;     // One swerve module's devices, see below
+            using Gyro = ...;       // GyroInterface, constructed from a CAN id
+            using World = ...;      // Everything outside the devices, see below
+        };
+
+    A Module has public members m_driveMotor and m_turnMotor (MotorInterface),
+    m_driveEncoder and m_turnEncoder (EncoderInterface, the motors' integrated encoders)
+    and m_absEncoder (AbsoluteEncoderInterface), and is constructed from
+    (driveMotorChannel, turningMotorChannel, turningEncoderPort, offset).
+
+    The World is constructed from (std::array<Module*, N>, std::array<ModuleLocation, N>, Gyro&)
+    with the modules in kinematics order, and has double Step(), called once at the start of
+    every loop, which moves the world to the current loop and returns its timestamp,
+    double GetTime() const, the time now, and static constexpr bool c_bRealTime, true if the
+    world moves on its own so the devices may be sampled between loops from another thread.
+*/
+
+#pragma once
+
+/// Position of a swerve module relative to the robot center, meters, +x forward, +y left
+struct ModuleLocation
+{
+    double m_x;
+    double m_y;
+};
+
+/// Control modes of the motor controller's onboard loop
+enum class EMotorControl
+{
+      eDutyCycle
+    , eVelocity
+    , ePosition
+};
+
+/// Smart motor controller with an onboard PID loop, e.g. a Spark MAX driving a NEO
+template <typename Impl>
+class MotorInterface
+{
+public:
+    void SetSmartCurrentLimit(unsigned amps) { Self().SetSmartCurrentLimitImpl(amps); }
+    void SetInverted(bool bInverted) { Self().SetInvertedImpl(bInverted); }
+
+    /// Periods of the status frames the controller sends, ms
+    void SetStatusFramePeriods(int status0Ms, int status1Ms, int status2Ms) { Self().SetStatusFramePeriodsImpl(status0Ms, status1Ms, status2Ms); }
+
+    void SetP(double p) { Self().SetPImpl(p); }
+    void SetI(double i) { Self().SetIImpl(i); }
+    void SetD(double d) { Self().SetDImpl(d); }
+    void SetIZone(double iz) { Self().SetIZoneImpl(iz); }
+    void SetFF(double ff) { Self().SetFFImpl(ff); }
+    void SetOutputRange(double min, double max) { Self().SetOutputRangeImpl(min, max); }
+
+    /// Position and velocity are in the units of the integrated encoder's conversion factors
+    void SetReference(double value, EMotorControl mode) { Self().SetReferenceImpl(value, mode); }
+
+    double GetAppliedOutput() { return Self().GetAppliedOutputImpl(); }
+    double GetOutputCurrent() { return Self().GetOutputCurrentImpl(); }
+
+private:
+    Impl& Self() { return static_cast<Impl&>(*this); }
+};
+
+/// Relative encoder, e.g. the NEO's integrated encoder read through the Spark MAX
+template <typename Impl>
+class EncoderInterface
+{
+public:
+    double GetPosition() { return Self().GetPositionImpl(); }
+    double GetVelocity() { return Self().GetVelocityImpl(); }
+    void SetPosition(double position) { Self().SetPositionImpl(position); }
+    void SetPositionConversionFactor(double factor) { Self().SetPositionConversionFactorImpl(factor); }
+    void SetVelocityConversionFactor(double factor) { Self().SetVelocityConversionFactorImpl(factor); }
+
+private:
+    Impl& Self() { return static_cast<Impl&>(*this); }
+};
+
+/// Analog absolute angle sensor, e.g. the swerve module's magnetic encoder
+template <typename Impl>
+class AbsoluteEncoderInterface
+{
+public:
+    /// Latest single sample
+    double GetVoltage() { return Self().GetVoltageImpl(); }
+
+    /// Hardware averaging, 2^(oversampleBits + averageBits) samples per averaged reading
+    void SetAveraging(int oversampleBits, int averageBits) { Self().SetAveragingImpl(oversampleBits, averageBits); }
+    /// Mean voltage over the last averaging window
+    double GetAverageVoltage() { return Self().GetAverageVoltageImpl(); }
+    /// Length of the averaging window, seconds
+    double GetAveragingWindow() { return Self().GetAveragingWindowImpl(); }
+
+private:
+    Impl& Self() { return static_cast<Impl&>(*this); }
+};
+
+template <typename Impl>
+class GyroInterface
+{
+public:
+    /// Degrees, counter clockwise positive, continuous (not wrapped)
+    double GetFusedHeading() { return Self().GetFusedHeadingImpl(); }
+    /// Degrees per second about the vertical axis from the raw gyro, counter clockwise positive
+    double GetYawRate() { return Self().GetYawRateImpl(); }
+    void ClearStickyFaults() { Self().ClearStickyFaultsImpl(); }
+
+    /// Periods of the status frames carrying the fused heading and the raw gyro rates, and of all the others, ms
+    void SetStatusFramePeriods(int usedMs, int unusedMs) { Self().SetStatusFramePeriodsImpl(usedMs, unusedMs); }
+
+private:
+    Impl& Self() { return static_cast<Impl&>(*this); }
+};
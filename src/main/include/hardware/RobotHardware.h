@@ -0,0 +1,202 @@
+/*
+    Real drivetrain hardware: Spark MAX motor controllers, analog absolute encoders and a Pigeon IMU
+*/
+
+#pragma once
+
+#include <frc/AnalogInput.h>
+#include <frc/Timer.h>
+
+#include <rev/CANSparkMax.h>
+#include <rev/CANEncoder.h>
+#include <rev/CANPIDController.h>
+
+#include <ctre/phoenix/sensors/PigeonIMU.h>
+
+#include <array>
+
+#include "Constants.h"
+#include "hardware/HardwareInterfaces.h"
+
+class SparkMaxMotor : public MotorInterface<SparkMaxMotor>
+{
+public:
+    explicit SparkMaxMotor(int deviceId)
+        : m_motor(deviceId, rev::CANSparkMax::MotorType::kBrushless)
+    {
+    }
+
+    rev::CANSparkMax& GetSparkMax() { return m_motor; }
+
+private:
+    friend class MotorInterface<SparkMaxMotor>;
+
+    void SetSmartCurrentLimitImpl(unsigned amps) { m_motor.SetSmartCurrentLimit(amps); }
+    void SetInvertedImpl(bool bInverted) { m_motor.SetInverted(bInverted); }
+
+    void SetStatusFramePeriodsImpl(int status0Ms, int status1Ms, int status2Ms)
+    {
+        using PeriodicFrame = rev::CANSparkMaxLowLevel::PeriodicFrame;
+        m_motor.SetPeriodicFramePeriod(PeriodicFrame::kStatus0, status0Ms);
+        m_motor.SetPeriodicFramePeriod(PeriodicFrame::kStatus1, status1Ms);
+        m_motor.SetPeriodicFramePeriod(PeriodicFrame::kStatus2, status2Ms);
+    }
+
+    void SetPImpl(double p) { m_pid.SetP(p); }
+    void SetIImpl(double i) { m_pid.SetI(i); }
+    void SetDImpl(double d) { m_pid.SetD(d); }
+    void SetIZoneImpl(double iz) { m_pid.SetIZone(iz); }
+    void SetFFImpl(double ff) { m_pid.SetFF(ff); }
+    void SetOutputRangeImpl(double min, double max) { m_pid.SetOutputRange(min, max); }
+
+    void SetReferenceImpl(double value, EMotorControl mode)
+    {
+        rev::ControlType type = mode == EMotorControl::ePosition ? rev::ControlType::kPosition
+                              : mode == EMotorControl::eVelocity ? rev::ControlType::kVelocity
+                              : rev::ControlType::kDutyCycle;
+        m_pid.SetReference(value, type);
+    }
+
+    double GetAppliedOutputImpl() { return m_motor.GetAppliedOutput(); }
+    double GetOutputCurrentImpl() { return m_motor.GetOutputCurrent(); }
+
+    rev::CANSparkMax m_motor;
+    rev::CANPIDController m_pid = m_motor.GetPIDController();
+};
+
+class SparkMaxEncoder : public EncoderInterface<SparkMaxEncoder>
+{
+public:
+    explicit SparkMaxEncoder(SparkMaxMotor& motor)
+        : m_encoder(motor.GetSparkMax().GetEncoder())
+    {
+    }
+
+private:
+    friend class EncoderInterface<SparkMaxEncoder>;
+
+    double GetPositionImpl() { return m_encoder.GetPosition(); }
+    double GetVelocityImpl() { return m_encoder.GetVelocity(); }
+    void SetPositionImpl(double position) { m_encoder.SetPosition(position); }
+    void SetPositionConversionFactorImpl(double factor) { m_encoder.SetPositionConversionFactor(factor); }
+    void SetVelocityConversionFactorImpl(double factor) { m_encoder.SetVelocityConversionFactor(factor); }
+
+    rev::CANEncoder m_encoder;
+};
+
+class AnalogAbsoluteEncoder : public AbsoluteEncoderInterface<AnalogAbsoluteEncoder>
+{
+public:
+    explicit AnalogAbsoluteEncoder(int channel)
+        : m_input(channel)
+    {
+    }
+
+private:
+    friend class AbsoluteEncoderInterface<AnalogAbsoluteEncoder>;
+
+    double GetVoltageImpl() { return m_input.GetVoltage(); }
+
+    void SetAveragingImpl(int oversampleBits, int averageBits)
+    {
+        m_input.SetOversampleBits(oversampleBits);
+        m_input.SetAverageBits(averageBits);
+    }
+
+    double GetAverageVoltageImpl() { return m_input.GetAverageVoltage(); }
+
+    double GetAveragingWindowImpl()
+    {
+        // The global sample rate is per channel
+        int samples = 1 << (m_input.GetOversampleBits() + m_input.GetAverageBits());
+        return samples / frc::AnalogInput::GetGlobalSampleRate();
+    }
+
+    frc::AnalogInput m_input;
+};
+
+class PigeonGyro : public GyroInterface<PigeonGyro>
+{
+public:
+    explicit PigeonGyro(int deviceId)
+        : m_pigeon(deviceId)
+    {
+    }
+
+private:
+    friend class GyroInterface<PigeonGyro>;
+
+    double GetFusedHeadingImpl() { return m_pigeon.GetFusedHeading(); }
+    void ClearStickyFaultsImpl() { m_pigeon.ClearStickyFaults(); }
+
+    double GetYawRateImpl()
+    {
+        double xyz[3];
+        m_pigeon.GetRawGyro(xyz);
+        return xyz[2];
+    }
+
+    void SetStatusFramePeriodsImpl(int usedMs, int unusedMs)
+    {
+        using namespace ctre::phoenix::sensors;
+
+        // Fused heading and raw gyro rates
+        m_pigeon.SetStatusFramePeriod(PigeonIMU_CondStatus_6_SensorFusion, usedMs);
+        m_pigeon.SetStatusFramePeriod(PigeonIMU_BiasedStatus_2_Gyro, usedMs);
+
+        // General status stays at its default, it carries the device state and faults
+        m_pigeon.SetStatusFramePeriod(PigeonIMU_CondStatus_2_GeneralCompass, unusedMs);
+        m_pigeon.SetStatusFramePeriod(PigeonIMU_CondStatus_3_GeneralAccel, unusedMs);
+        m_pigeon.SetStatusFramePeriod(PigeonIMU_CondStatus_9_SixDeg_YPR, unusedMs);
+        m_pigeon.SetStatusFramePeriod(PigeonIMU_CondStatus_10_SixDeg_Quat, unusedMs);
+        m_pigeon.SetStatusFramePeriod(PigeonIMU_CondStatus_11_GyroAccum, unusedMs);
+        m_pigeon.SetStatusFramePeriod(PigeonIMU_RawStatus_4_Mag, unusedMs);
+        m_pigeon.SetStatusFramePeriod(PigeonIMU_BiasedStatus_4_Mag, unusedMs);
+        m_pigeon.SetStatusFramePeriod(PigeonIMU_BiasedStatus_6_Accel, unusedMs);
+    }
+
+    ctre::phoenix::sensors::PigeonIMU m_pigeon;
+};
+
+/// One swerve module's devices
+struct SparkMaxModuleHardware
+{
+    /// @param offset   Not needed by the real hardware, the magnet is where it is
+    SparkMaxModuleHardware(int driveMotorChannel, int turningMotorChannel, int turningEncoderPort, double /* offset */)
+        : m_driveMotor(driveMotorChannel)
+        , m_turnMotor(turningMotorChannel)
+        , m_driveEncoder(m_driveMotor)
+        , m_turnEncoder(m_turnMotor)
+        , m_absEncoder(turningEncoderPort)
+    {
+    }
+
+    SparkMaxMotor m_driveMotor;
+    SparkMaxMotor m_turnMotor;
+    SparkMaxEncoder m_driveEncoder;
+    SparkMaxEncoder m_turnEncoder;
+    AnalogAbsoluteEncoder m_absEncoder;
+};
+
+/// The real world moves on its own, stepping it only reads the clock
+class RobotWorld
+{
+public:
+    RobotWorld( const std::array<SparkMaxModuleHardware*, DriveConstants::kNumSwerveModules>&
+              , const std::array<ModuleLocation, DriveConstants::kNumSwerveModules>&
+              , PigeonGyro&)
+    {
+    }
+
+    static constexpr bool c_bRealTime = true;
+
+    double Step() { return frc::Timer::GetFPGATimestamp(); }
+    double GetTime() const { return frc::Timer::GetFPGATimestamp(); }
+};
+
+struct RobotHardware
+{
+    using Module = SparkMaxModuleHardware;
+    using Gyro = PigeonGyro;
+    using World = RobotWorld;
+};
@@ -0,0 +1,208 @@
+/*
+    Simulated drivetrain hardware
+
+    The devices hold the state a physics model moves (see DrivetrainSim) and model what
+    sits between the setpoint and the shaft: the Spark MAX onboard PID loop, smart current
+    limit and the NEO's electrical characteristics.
+
+    Motor state is kept the way a Spark MAX keeps it, rotor revolutions and RPM, with the
+    integrated encoder's zero and conversion factors applied on top. Position and velocity
+    references are in encoder units, as on the real controller. The modules are modelled
+    as mounted the way the configured inversion expects, so inversion does not change the
+    direction of the rotor.
+*/
+
+#pragma once
+
+#include <cmath>
+#include <random>
+
+#include "AngleMath.h"
+#include "Constants.h"
+#include "hardware/HardwareInterfaces.h"
+
+class DrivetrainSim;
+
+class SimMotor : public MotorInterface<SimMotor>
+{
+public:
+    explicit SimMotor(int deviceId)
+        : m_deviceId(deviceId)
+    {
+    }
+
+    int GetDeviceId() const { return m_deviceId; }
+
+    /// Runs one period of the onboard control loop at the current rotor speed and returns the
+    /// torque on the rotor, Nm. Call once per physics step.
+    double Step();
+
+    /// Physical rotor state, not affected by the encoder zero or conversion factors
+    double GetRotorRevs() const { return m_rotorRevs; }
+    double GetRotorRpm() const { return m_rotorRpm; }
+    void SetRotor(double revs, double rpm) { m_rotorRevs = revs; m_rotorRpm = rpm; }
+
+private:
+    friend class MotorInterface<SimMotor>;
+    friend class SimEncoder;
+
+    void SetSmartCurrentLimitImpl(unsigned amps) { m_currentLimit = amps; }
+    void SetInvertedImpl(bool bInverted) { m_bInverted = bInverted; }
+    void SetStatusFramePeriodsImpl(int, int, int) {}
+
+    void SetPImpl(double p) { m_p = p; }
+    void SetIImpl(double i) { m_i = i; }
+    void SetDImpl(double d) { m_d = d; }
+    void SetIZoneImpl(double iz) { m_iZone = iz; }
+    void SetFFImpl(double ff) { m_ff = ff; }
+    void SetOutputRangeImpl(double min, double max) { m_minOutput = min; m_maxOutput = max; }
+
+    void SetReferenceImpl(double value, EMotorControl mode)
+    {
+        if (mode != m_mode)
+        {
+            m_iAccum = 0.0;
+        }
+        m_reference = value;
+        m_mode = mode;
+    }
+
+    double GetAppliedOutputImpl() { return m_appliedOutput; }
+    double GetOutputCurrentImpl() { return fabs(m_current); }
+
+    double GetEncoderPosition() const { return (m_rotorRevs - m_zeroRevs) * m_positionFactor; }
+    double GetEncoderVelocity() const { return m_rotorRpm * m_velocityFactor; }
+
+    int m_deviceId;
+    bool m_bInverted = false;
+    double m_currentLimit = 80.0;
+
+    // Onboard PID loop, in encoder units
+    double m_p = 0.0;
+    double m_i = 0.0;
+    double m_d = 0.0;
+    double m_iZone = 0.0;
+    double m_ff = 0.0;
+    double m_minOutput = -1.0;
+    double m_maxOutput = 1.0;
+    EMotorControl m_mode = EMotorControl::eDutyCycle;
+    double m_reference = 0.0;
+    double m_iAccum = 0.0;
+    double m_prevError = 0.0;
+
+    double m_appliedOutput = 0.0;
+    double m_current = 0.0;             //!< Signed, positive drives the rotor forward
+
+    double m_rotorRevs = 0.0;
+    double m_rotorRpm = 0.0;
+
+    // Integrated encoder, see SimEncoder
+    double m_zeroRevs = 0.0;            //!< Rotor position where the encoder reads 0
+    double m_positionFactor = 1.0;
+    double m_velocityFactor = 1.0;
+};
+
+/// The integrated encoder of a SimMotor
+class SimEncoder : public EncoderInterface<SimEncoder>
+{
+public:
+    explicit SimEncoder(SimMotor& motor)
+        : m_motor(motor)
+    {
+    }
+
+private:
+    friend class EncoderInterface<SimEncoder>;
+
+    double GetPositionImpl() { return m_motor.GetEncoderPosition(); }
+    double GetVelocityImpl() { return m_motor.GetEncoderVelocity(); }
+    /// Moves the encoder zero, not the rotor
+    void SetPositionImpl(double position) { m_motor.m_zeroRevs = m_motor.m_rotorRevs - position / m_motor.m_positionFactor; }
+    void SetPositionConversionFactorImpl(double factor) { m_motor.m_positionFactor = factor; }
+    void SetVelocityConversionFactorImpl(double factor) { m_motor.m_velocityFactor = factor; }
+
+    SimMotor& m_motor;
+};
+
+/// Absolute encoder on the wheel steered by a SimMotor, rotor position 0 is wheel angle 0
+class SimAbsoluteEncoder : public AbsoluteEncoderInterface<SimAbsoluteEncoder>
+{
+public:
+    /// @param offset   Where the magnet sits, as calibrated in DriveConstants
+    SimAbsoluteEncoder(const SimMotor& turnMotor, int channel, double offset)
+        : m_turnMotor(turnMotor)
+        , m_offset(offset)
+        , m_rng(SimConstants::kRandomSeed + channel)
+        , m_noise(0.0, SimConstants::kAbsEncoderNoiseVolts)
+    {
+    }
+
+    /// Wheel angle in radians, unwrapped
+    double GetWheelAngle() const
+    {
+        return m_turnMotor.GetRotorRevs() * AngleMath::c_2pi / DriveConstants::kTurnMotorRevsPerWheelRev;
+    }
+
+private:
+    friend class AbsoluteEncoderInterface<SimAbsoluteEncoder>;
+
+    double GetVoltageImpl();
+    void SetAveragingImpl(int oversampleBits, int averageBits) { m_samplesPerAverage = 1 << (oversampleBits + averageBits); }
+    double GetAverageVoltageImpl();
+    double GetAveragingWindowImpl() { return m_samplesPerAverage / SimConstants::kAnalogSampleRate; }
+
+    const SimMotor& m_turnMotor;
+    double m_offset;
+    int m_samplesPerAverage = 1;
+    std::mt19937 m_rng;
+    std::normal_distribution<double> m_noise;
+};
+
+class SimGyro : public GyroInterface<SimGyro>
+{
+public:
+    explicit SimGyro(int /* deviceId */) {}
+
+    void SetHeading(double degrees, double degreesPerSec)
+    {
+        m_heading = degrees;
+        m_rate = degreesPerSec;
+    }
+
+private:
+    friend class GyroInterface<SimGyro>;
+
+    double GetFusedHeadingImpl() { return m_heading; }
+    double GetYawRateImpl() { return m_rate; }
+    void ClearStickyFaultsImpl() {}
+    void SetStatusFramePeriodsImpl(int /* usedMs */, int /* unusedMs */) {}
+
+    double m_heading = 0.0;
+    double m_rate = 0.0;
+};
+
+/// One simulated swerve module's devices
+struct SimModuleHardware
+{
+    SimModuleHardware(int driveMotorChannel, int turningMotorChannel, int turningEncoderPort, double offset)
+        : m_driveMotor(driveMotorChannel)
+        , m_turnMotor(turningMotorChannel)
+        , m_driveEncoder(m_driveMotor)
+        , m_turnEncoder(m_turnMotor)
+        , m_absEncoder(m_turnMotor, turningEncoderPort, offset)
+    {
+    }
+
+    SimMotor m_driveMotor;
+    SimMotor m_turnMotor;
+    SimEncoder m_driveEncoder;
+    SimEncoder m_turnEncoder;
+    SimAbsoluteEncoder m_absEncoder;
+};
+
+struct SimHardware
+{
+    using Module = SimModuleHardware;
+    using Gyro = SimGyro;
+    using World = DrivetrainSim;        //!< hardware/DrivetrainSim.h
+};
@@ -8,19 +8,30 @@
 #pragma once
 
 #include <frc/Encoder.h>
+#include <frc/Notifier.h>
 #include <frc/geometry/Pose2d.h>
 #include <frc/geometry/Rotation2d.h>
 #include <frc/kinematics/ChassisSpeeds.h>
 #include <frc/kinematics/SwerveDriveKinematics.h>
 #include <frc/kinematics/SwerveDriveOdometry.h>
 #include <frc2/command/SubsystemBase.h>
-#include <ctre/phoenix.h>
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
 
 #include "Constants.h"
+#include "hardware/Hardware.h"
+#include "GyroService.h"
+#include "PoseHistory.h"
+#include "SeqLock.h"
+#include "SwerveKinematics.h"
 #include "SwerveModule.h"
 #include "Logger.h"
 
-// For each enum here, add a string to c_headerNamesDriveSubsystem
+// For each enum here, add an entry to LogDataSchema<EDriveSubSystemLogData>
 // and a line like this: 
 //      m_logData[EDriveSubSystemLogData::e???] = ???;
 // to DriveSubsystem::Periodic
@@ -36,15 +47,31 @@ enum class EDriveSubSystemLogData : int
   , eOdoX
   , eOdoY
   , eOdoRot
+  , eTurnRate
   , eLastDouble
 };
 
-const std::vector<std::string> c_headerNamesDriveSubsystem{ "InputX", "InputY", "InputRot", "OdoX", "OdoY", "OdoRot"};
+template <>
+struct LogDataSchema<EDriveSubSystemLogData>
+{
+    static constexpr LogField<EDriveSubSystemLogData> c_fields[] =
+    {
+          { EDriveSubSystemLogData::eInputX,    "InputX" }
+        , { EDriveSubSystemLogData::eInputY,    "InputY" }
+        , { EDriveSubSystemLogData::eInputRot,  "InputRot" }
+        , { EDriveSubSystemLogData::eOdoX,      "OdoX", 0.01 }
+        , { EDriveSubSystemLogData::eOdoY,      "OdoY", 0.01 }
+        , { EDriveSubSystemLogData::eOdoRot,    "OdoRot" }
+        , { EDriveSubSystemLogData::eTurnRate,  "TurnRate", 0.5 }
+    };
+};
 
-class DriveSubsystem : public frc2::SubsystemBase
+/// The drivetrain on the hardware set Hw, see hardware/HardwareInterfaces.h
+template <typename Hw>
+class DriveSubsystemT : public frc2::SubsystemBase
 {
 public:
-    enum EModuleLocation    //!< Order as returned by kDriveKinematics.ToSwerveModuleStates
+    enum EModuleLocation    //!< Order of DriveConstants::kModuleConfigs and kDriveKinematics.ToSwerveModuleStates
     {
         eFrontLeft,
         eFrontRight,
@@ -52,7 +79,7 @@ public:
         eRearRight
     };
 
-    DriveSubsystem(Logger& log);
+    DriveSubsystemT(Logger& log);
 
     /// Will be called periodically whenever the CommandScheduler runs.
     void Periodic() override;
@@ -76,7 +103,7 @@ public:
     using SwerveModuleStates = std::array<frc::SwerveModuleState, DriveConstants::kNumSwerveModules>;
     void SetModuleStates(SwerveModuleStates desiredStates);
 
-    /// Returns the heading of the robot.
+    /// Returns the heading of the robot, as of the last gyro sample.
     /// @return the robot's heading in degrees, from -180 to 180
     double GetHeading();
     frc::Rotation2d GetHeadingAsRot2d() { return frc::Rotation2d(degree_t(GetHeading())); }
@@ -84,11 +111,11 @@ public:
     /// Zeroes the heading of the robot.
     void ZeroHeading();
 
-    /// Returns the turn rate of the robot.
+    /// Returns the turn rate of the robot, as of the last gyro sample.
     /// @return The turn rate of the robot, in degrees per second
     double GetTurnRate();
 
-    /// Returns the currently-estimated pose of the robot.
+    /// Returns the currently-estimated pose of the robot. Never waits on the odometry thread.
     /// @return The pose.
     frc::Pose2d GetPose();
 
@@ -96,27 +123,116 @@ public:
     /// @param pose The pose to which to set the odometry.
     void ResetOdometry(frc::Pose2d pose);
 
-    meter_t kTrackWidth = 21.5_in; // Distance between centers of right and left wheels on robot
-    meter_t kWheelBase = 23.5_in;  // Distance between centers of front and back wheels on robot
+    /// Pose the odometry had at timestamp, interpolated between updates
+    /// @param timestamp    Seconds on the loop clock, GetWorld().GetTime()
+    /// @return False if timestamp is older than the last DriveConstants::kPoseHistoryLength updates
+    bool GetPoseAt(double timestamp, frc::Pose2d& pose);
+
+    /// Corrects the odometry with a pose measured in the past, e.g. from a camera image taken
+    /// before it was processed. The odometry's motion since timestamp is replayed on top of it.
+    /// @return False, and the odometry is left alone, if timestamp is older than the history
+    bool AddPoseMeasurement(const frc::Pose2d& pose, double timestamp);
+
+    /// The physics model when simulated, see hardware/DrivetrainSim.h
+    typename Hw::World& GetWorld() { return m_world; }
 
-    frc::SwerveDriveKinematics<DriveConstants::kNumSwerveModules> kDriveKinematics{
-        frc::Translation2d( kWheelBase / 2,  kTrackWidth / 2),    // +x, +y FL
-        frc::Translation2d( kWheelBase / 2, -kTrackWidth / 2),    // +x, -y FR
-        frc::Translation2d(-kWheelBase / 2,  kTrackWidth / 2),    // -x, +y RL
-        frc::Translation2d(-kWheelBase / 2, -kTrackWidth / 2)};   // -x, -y RR
+    /// The modules' devices in DriveConstants::kModuleConfigs order, e.g. for a batch run in
+    /// the simulation to set controller gains without the dashboard
+    std::array<typename Hw::Module*, DriveConstants::kNumSwerveModules> GetModuleHardware();
 
-private:    
+    // How the constructor builds the modules and the World, public so a test can build the
+    // same thing around the modules alone
+    using Modules = std::array<SwerveModuleT<Hw>, DriveConstants::kNumSwerveModules>;
+
+    /// One module per DriveConstants::kModuleConfigs entry, in order
+    static Modules MakeModules(Logger& log) { return MakeModules(log, std::make_index_sequence<DriveConstants::kNumSwerveModules>()); }
+    static std::array<typename Hw::Module*, DriveConstants::kNumSwerveModules> GetModuleHardware(Modules& modules);
+    static std::array<ModuleLocation, DriveConstants::kNumSwerveModules> GetModuleLocations();
+
+    frc::SwerveDriveKinematics<DriveConstants::kNumSwerveModules> kDriveKinematics = MakeKinematics(std::make_index_sequence<DriveConstants::kNumSwerveModules>());
+
+private:
+    /// Drive and SetModuleStates go through this rather than kDriveKinematics, which is kept for the odometry and trajectory following
+    static constexpr SwerveKinematics<DriveConstants::kNumSwerveModules> c_kinematics{DriveConstants::kModuleConfigs};
+    
     using LogData = LogDataT<EDriveSubSystemLogData>;
+    template <typename T>
+    using PerModule = std::array<T, DriveConstants::kNumSwerveModules>;
+
+    /// Per module values of one loop, one array per quantity, in DriveConstants::kModuleConfigs order
+    struct ModuleArrays
+    {
+        PerModule<double> m_turnPosition;       //!< SwerveModule::PrepareTurn
+        PerModule<double> m_desiredAngle;
+        PerModule<double> m_minTurnRads;
+        PerModule<bool> m_bOutputReverse;
+    };
+
+    template <size_t... I>
+    static Modules MakeModules(Logger& log, std::index_sequence<I...>)
+    {
+        return {{ SwerveModuleT<Hw>(DriveConstants::kModuleConfigs[I], log)... }};
+    }
+
+    template <size_t... I>
+    static frc::SwerveDriveKinematics<DriveConstants::kNumSwerveModules> MakeKinematics(std::index_sequence<I...>)
+    {
+        return frc::SwerveDriveKinematics<DriveConstants::kNumSwerveModules>
+        {
+            frc::Translation2d(meter_t(DriveConstants::kModuleConfigs[I].m_x), meter_t(DriveConstants::kModuleConfigs[I].m_y))...
+        };
+    }
+
+    /// Pose as published to GetPose
+    struct PublishedPose
+    {
+        double m_x;             //!< Meters
+        double m_y;
+        double m_rotation;      //!< Radians
+    };
+
+    /// Advances the odometry to timestamp and publishes the new pose, from Periodic or the odometry thread
+    template <size_t... I>
+    void UpdateOdometry(double timestamp, const SwerveModuleStates& states, std::index_sequence<I...>)
+    {
+        frc::Rotation2d heading = GetHeadingAsRot2d();
+        std::lock_guard<std::mutex> lock(m_odometryMutex);
+        const frc::Pose2d& pose = m_odometry.UpdateWithTime(second_t(timestamp), heading, states[I]...);
+        PublishPose(pose);
+        m_poseHistory.Push({ timestamp, pose.Translation().X().to<double>(), pose.Translation().Y().to<double>(), pose.Rotation().Radians().to<double>()
+                           , heading.Radians().to<double>(), {{ { states[I].speed.to<double>(), states[I].angle.Radians().to<double>() }... }} });
+    }
+
+    /// Call with m_odometryMutex held
+    void PublishPose(const frc::Pose2d& pose);
+
+    /// One step of the odometry thread, at DriveConstants::kOdometryHz
+    void OdometryThreadStep();
+
+    /// Sends already normalized states to the modules
+    void ApplyModuleStates(const SwerveModuleStates& desiredStates);
 
     Logger& m_log;
     LogData m_logData;
+    int m_logSiteId = -1;
+
+    Modules m_modules;
+    ActuatorWorker m_actuatorWorker;        //!< Sends the modules' setpoints when CanConstants::kActuatorThread, after m_modules so it stops first
+    SwerveModuleStates m_moduleStates;      //!< Measured this loop
+    ModuleArrays m_moduleArrays;
 
-    SwerveModule m_frontLeft;
-    SwerveModule m_frontRight;
-    SwerveModule m_rearRight;
-    SwerveModule m_rearLeft;
+    typename Hw::Gyro m_gyro;
+    typename Hw::World m_world;     //!< Stepped at the start of Periodic
+    GyroService<typename Hw::Gyro> m_gyroService;      //!< Sampled where the odometry is updated
 
-    PigeonIMU m_gyro;
-    // Odometry class for tracking robot pose
+    // Odometry class for tracking robot pose. Updated by Periodic, or by the odometry thread
+    // when c_bOdometryThread<Hw>; the mutex keeps the other users of it and its history out
+    // of a thread update.
+    std::mutex m_odometryMutex;
     frc::SwerveDriveOdometry<DriveConstants::kNumSwerveModules> m_odometry;
+    PoseHistory<DriveConstants::kNumSwerveModules, DriveConstants::kPoseHistoryLength> m_poseHistory;
+    SeqLock<PublishedPose> m_pose;
+    std::unique_ptr<frc::Notifier> m_odometryNotifier;     //!< Last, so it stops before anything it uses goes away
 };
+
+using DriveSubsystem = DriveSubsystemT<Hardware>;
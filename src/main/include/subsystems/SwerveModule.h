@@ -7,26 +7,28 @@
 
 #pragma once
 
-#include <frc/AnalogInput.h>
 #include <frc/controller/PIDController.h>
 #include <frc/controller/ProfiledPIDController.h>
 #include <frc/geometry/Rotation2d.h>
 #include <frc/kinematics/SwerveModuleState.h>
 #include <frc/trajectory/TrapezoidProfile.h>
-#include <frc/SmartDashboard/SmartDashboard.h>
+#include <frc/smartdashboard/SmartDashboard.h>
 #include <networktables/NetworkTableEntry.h>
 
-#include <rev\CANSparkMax.h>
-#include <rev\CANEncoder.h>
-
 #include <wpi/math>
 
+#include <atomic>
 #include <string>
 
+#include "AbsoluteAngleFilter.h"
+#include "ActuatorWorker.h"
+#include "AngleMath.h"
 #include "Constants.h"
+#include "hardware/Hardware.h"
 #include "Logger.h"
+#include "SparkMaxTraffic.h"
+#include "Tunables.h"
 
-using namespace rev;
 using namespace units;
 
 
@@ -40,8 +42,18 @@ class TurnPidParams
     double m_max = 1.0;
     double m_min = -1.0;
 
+    // Dashboard copies, shared by all modules
+    Tunable* m_tuneP = nullptr;
+    Tunable* m_tuneI = nullptr;
+    Tunable* m_tuneD = nullptr;
+    Tunable* m_tuneIz = nullptr;
+    Tunable* m_tuneFf = nullptr;
+    Tunable* m_tuneMax = nullptr;
+    Tunable* m_tuneMin = nullptr;
+
 public:
-    void Load(CANPIDController& turnPIDController)
+    template <typename Motor>
+    void Load(MotorInterface<Motor>& turnPIDController)
     {
         turnPIDController.SetP(m_p);
         turnPIDController.SetI(m_i);
@@ -49,24 +61,27 @@ public:
         turnPIDController.SetIZone(m_iz);
         turnPIDController.SetFF(m_ff);
         turnPIDController.SetOutputRange(m_min, m_max);
-        frc::SmartDashboard::PutNumber("Turn P Gain", m_p);
-        frc::SmartDashboard::PutNumber("Turn I Gain", m_i);
-        frc::SmartDashboard::PutNumber("Turn D Gain", m_d);
-        frc::SmartDashboard::PutNumber("Turn I Zone", m_iz);
-        frc::SmartDashboard::PutNumber("Turn Feed Forward", m_ff);
-        frc::SmartDashboard::PutNumber("Turn Max Output", m_max);
-        frc::SmartDashboard::PutNumber("Turn Min Output", m_min);
+        Tunables& tunables = Tunables::GetInstance();
+        m_tuneP = &tunables.Add("Turn P Gain", m_p);
+        m_tuneI = &tunables.Add("Turn I Gain", m_i);
+        m_tuneD = &tunables.Add("Turn D Gain", m_d);
+        m_tuneIz = &tunables.Add("Turn I Zone", m_iz);
+        m_tuneFf = &tunables.Add("Turn Feed Forward", m_ff);
+        m_tuneMax = &tunables.Add("Turn Max Output", m_max);
+        m_tuneMin = &tunables.Add("Turn Min Output", m_min);
     }
 
-    void LoadFromNetworkTable(CANPIDController& turnPIDController)
+    /// Call when Tunables reports a change
+    template <typename Motor>
+    void Apply(MotorInterface<Motor>& turnPIDController)
     {
-        double p = frc::SmartDashboard::GetNumber("Turn P Gain", 0.0);
-        double i = frc::SmartDashboard::GetNumber("Turn I Gain", 0.0);
-        double d = frc::SmartDashboard::GetNumber("Turn D Gain", 0.0);
-        double iz = frc::SmartDashboard::GetNumber("Turn I Zone", 0.0);
-        double ff = frc::SmartDashboard::GetNumber("Turn Feed Forward", 0.0);
-        double max = frc::SmartDashboard::GetNumber("Turn Max Output", 0.0);
-        double min = frc::SmartDashboard::GetNumber("Turn Min Output", 0.0);
+        double p = m_tuneP->Get();
+        double i = m_tuneI->Get();
+        double d = m_tuneD->Get();
+        double iz = m_tuneIz->Get();
+        double ff = m_tuneFf->Get();
+        double max = m_tuneMax->Get();
+        double min = m_tuneMin->Get();
 
         // if PID coefficients on SmartDashboard have changed, write new values to controller
         if ((p != m_p)) { turnPIDController.SetP(p); m_p = p; }
@@ -93,31 +108,41 @@ class DrivePidParams
     double m_max = 1.0;
     double m_min = -1.0;
 
+    // Dashboard copies, shared by all modules
+    Tunable* m_tuneP = nullptr;
+    Tunable* m_tuneD = nullptr;
+    Tunable* m_tuneFf = nullptr;
+    Tunable* m_tuneMax = nullptr;
+    Tunable* m_tuneMin = nullptr;
+
 public:
-   void Load(CANPIDController& drivePIDController)
+    template <typename Motor>
+    void Load(MotorInterface<Motor>& drivePIDController)
     {
         drivePIDController.SetP(m_p);
         // drivePIDController.SetI(m_i);
         drivePIDController.SetD(m_d);
         drivePIDController.SetFF(m_ff);
         drivePIDController.SetOutputRange(m_min, m_max);
-        frc::SmartDashboard::PutNumber("Drive P Gain", m_p);
-        //frc::SmartDashboard::PutNumber("Drive I Gain", m_i);
-        frc::SmartDashboard::PutNumber("Drive D Gain", m_d);
-        frc::SmartDashboard::PutNumber("Drive Feed Forward", m_ff);
-        frc::SmartDashboard::PutNumber("Drive Max Output", m_max);
-        frc::SmartDashboard::PutNumber("Drive Min Output", m_min);
+        Tunables& tunables = Tunables::GetInstance();
+        m_tuneP = &tunables.Add("Drive P Gain", m_p);
+        //m_tuneI = &tunables.Add("Drive I Gain", m_i);
+        m_tuneD = &tunables.Add("Drive D Gain", m_d);
+        m_tuneFf = &tunables.Add("Drive Feed Forward", m_ff);
+        m_tuneMax = &tunables.Add("Drive Max Output", m_max);
+        m_tuneMin = &tunables.Add("Drive Min Output", m_min);
     }
 
-    void LoadFromNetworkTable(CANPIDController& drivePIDController)
+    /// Call when Tunables reports a change
+    template <typename Motor>
+    void Apply(MotorInterface<Motor>& drivePIDController)
     {
-        // Retrieving drive PID values from SmartDashboard
-        double p = frc::SmartDashboard::GetNumber("Drive P Gain", 0.0);
-        //double i = frc::SmartDashboard::GetNumber("Drive I Gain", 0.0);
-        double d = frc::SmartDashboard::GetNumber("Drive D Gain", 0.0);
-        double ff = frc::SmartDashboard::GetNumber("Drive Feed Forward", 0.0);
-        double max = frc::SmartDashboard::GetNumber("Drive Max Output", 0.0);
-        double min = frc::SmartDashboard::GetNumber("Drive Min Output", 0.0);
+        double p = m_tuneP->Get();
+        //double i = m_tuneI->Get();
+        double d = m_tuneD->Get();
+        double ff = m_tuneFf->Get();
+        double max = m_tuneMax->Get();
+        double min = m_tuneMin->Get();
 
         // if PID coefficients on SmartDashboard have changed, write new values to controller
         if ((p != m_p)) { drivePIDController.SetP(p); m_p = p; }
@@ -134,78 +159,146 @@ public:
     }
 };
 
-// For each enum here, add a string to c_headerNamesSwerveModule
+// For each enum here, add an entry to LogDataSchema<ESwerveModuleLogData>
 // and a line like this: 
 //      m_logData[ESwerveModuleLogData::e???] = ???;
-// to SwerveModule::Periodic
+// to SwerveModule::SetDesiredState
 enum class ESwerveModuleLogData : int
 {
       eFirstInt
-    , eLastInt = eFirstInt
+    , eOutputReverse = eFirstInt
+    , eLastInt
 
-    , eFirstDouble
+    , eFirstDouble = eLastInt
     , eDesiredAngle = eFirstDouble
     , eTurnEncVolts
     , eTurnEncAngle
+    , eTurnEncRate
+    , eTurnEncNoise
     , eMinTurnRads
+    , eTurnFrameError
     , eTurnNeoPidRefPos
     , eTurnNeoEncoderPos
     , eTurnOutputDutyCyc
     , eDrivePidRefSpeed
     , eDriveEncVelocity
+    , eDriveSpeedError
     , eDriveOutputDutyCyc
+    , eTurnOutputCurrent
+    , eDriveOutputCurrent
+    , eDriveCanLoad
+    , eTurnCanLoad
+    , eDriveWriteLatency
+    , eTurnWriteLatency
+    , eDriveQueueAge
+    , eTurnQueueAge
     , eLastDouble
 };
 
-const std::vector<std::string> c_headerNamesSwerveModule
+template <>
+struct LogDataSchema<ESwerveModuleLogData>
 {
-      "desiredAngle"
-    , "turnEncVolts"
-    , "turnEncAngle"
-    , "minTurnRads"
-    , "turnNeoPidRefPos"
-    , "turnNeoEncoderPos"
-    , "turnOutputDutyCyc"
-    , "drivePidRefSpeed"
-    , "driveEncVelocity"
-    , "driveOutputDutyCyc"
+    static constexpr LogField<ESwerveModuleLogData> c_fields[] =
+    {
+          { ESwerveModuleLogData::eOutputReverse,       "outputReverse" }
+        , { ESwerveModuleLogData::eDesiredAngle,        "desiredAngle" }
+        , { ESwerveModuleLogData::eTurnEncVolts,        "turnEncVolts", 0.005 }
+        , { ESwerveModuleLogData::eTurnEncAngle,        "turnEncAngle" }
+        , { ESwerveModuleLogData::eTurnEncRate,         "turnEncRate", 0.05 }
+        , { ESwerveModuleLogData::eTurnEncNoise,        "turnEncNoise", 0.001, 1.0 }
+        , { ESwerveModuleLogData::eMinTurnRads,         "minTurnRads" }
+        , { ESwerveModuleLogData::eTurnFrameError,      "turnFrameError", 0.005 }
+        , { ESwerveModuleLogData::eTurnNeoPidRefPos,    "turnNeoPidRefPos" }
+        , { ESwerveModuleLogData::eTurnNeoEncoderPos,   "turnNeoEncoderPos" }
+        , { ESwerveModuleLogData::eTurnOutputDutyCyc,   "turnOutputDutyCyc" }
+        , { ESwerveModuleLogData::eDrivePidRefSpeed,    "drivePidRefSpeed" }
+        , { ESwerveModuleLogData::eDriveEncVelocity,    "driveEncVelocity" }
+        , { ESwerveModuleLogData::eDriveSpeedError,     "driveSpeedError" }
+        , { ESwerveModuleLogData::eDriveOutputDutyCyc,  "driveOutputDutyCyc" }
+        , { ESwerveModuleLogData::eTurnOutputCurrent,   "turnOutputCurrent", 0.25, 0.5 }
+        , { ESwerveModuleLogData::eDriveOutputCurrent,  "driveOutputCurrent", 0.25, 0.5 }
+        , { ESwerveModuleLogData::eDriveCanLoad,        "driveCanLoad", 0.001, 1.0 }
+        , { ESwerveModuleLogData::eTurnCanLoad,         "turnCanLoad", 0.001, 1.0 }
+        , { ESwerveModuleLogData::eDriveWriteLatency,   "driveWriteLatency", 1.0e-4, 1.0 }
+        , { ESwerveModuleLogData::eTurnWriteLatency,    "turnWriteLatency", 1.0e-4, 1.0 }
+        , { ESwerveModuleLogData::eDriveQueueAge,       "driveQueueAge", 1.0e-4, 1.0 }
+        , { ESwerveModuleLogData::eTurnQueueAge,        "turnQueueAge", 1.0e-4, 1.0 }
+    };
 };
 
-class SwerveModule
+/// Everything a module reads from its hardware in one loop, filled in once by SwerveModule::Sample
+struct SwerveModuleSample
+{
+    double m_timestamp = 0.0;           //!< FPGA time of the sample, seconds
+    double m_turnEncVolts = 0.0;        //!< Absolute encoder, averaged when the reading was clear of the wrap
+    double m_turnEncAngle = 0.0;        //!< Absolute encoder with the offset applied, filtered, radians
+    double m_turnEncRate = 0.0;         //!< Radians per second
+    double m_turnEncNoise = 0.0;        //!< Radians, 1 sigma
+    double m_turnEncLatency = 0.0;      //!< Age of the reading, already compensated in m_turnEncAngle, seconds
+    double m_turnNeoPosition = 0.0;     //!< Turn NEO encoder, radians
+    double m_driveVelocity = 0.0;       //!< Meters per second
+    double m_turnOutputDutyCyc = 0.0;
+    double m_driveOutputDutyCyc = 0.0;
+    double m_turnOutputCurrent = 0.0;
+    double m_driveOutputCurrent = 0.0;
+};
+
+/// True if the drivetrain on hardware set Hw updates its odometry on a thread of its own
+template <typename Hw>
+constexpr bool c_bOdometryThread = DriveConstants::kOdometryThread && Hw::World::c_bRealTime;
+
+/// One swerve module on the hardware set Hw, see hardware/HardwareInterfaces.h
+template <typename Hw>
+class SwerveModuleT
 {
     using radians_per_second_squared_t = compound_unit<radians, inverse<squared<second>>>;
 
 public:
-    SwerveModule( int driveMotorChannel
-                , int turningMotorChannel
-                , const int driveEncoderPort
-                , const int turningEncoderPort
-                , bool driveEncoderReversed
-                , bool turningEncoderReversed
-                , double offSet
-                , const std::string& name
-                , Logger& log);
+    SwerveModuleT(const DriveConstants::SwerveModuleConfig& config, Logger& log);
+
+    /// The module's devices, e.g. for a simulation to step
+    typename Hw::Module& GetHardware() { return m_hw; }
+
+    /// Reads all sensors once for this loop. Call before GetState and SetDesiredState.
+    /// Dashboard tuning changes are applied here too.
+    void Sample(double timestamp);
+    const SwerveModuleSample& GetSample() const { return m_sample; }
 
     frc::SwerveModuleState GetState();
 
-    void SetDesiredState(frc::SwerveModuleState &state);
+    /// State read straight from the motor controllers' latest status frames, for the odometry
+    /// thread. The angle is the turn NEO position moved into the absolute frame by the
+    /// difference between the two at the last Sample.
+    frc::SwerveModuleState ReadState();
+
+    /// Position the turn to a new angle is measured from this loop, radians: the turn NEO
+    /// position (resynced to the absolute encoder when the module is still) with
+    /// ModuleConstants::kTurnInNeoFrame, the absolute angle otherwise
+    /// @param speed    Speed about to be asked for, m/s
+    double PrepareTurn(double speed);
+
+    /// @param minTurnRads      AngleMath::MinTurnRads from the PrepareTurn position to state.angle
+    /// @param bOutputReverse   The turn ends half a turn from state.angle, drive backwards
+    void SetDesiredState(const frc::SwerveModuleState& state, double minTurnRads, bool bOutputReverse);
 
     void ResetEncoders();
 
-private:
-    double VoltageToRadians(double Voltage, double Offset);
-    double VoltageToDegrees(double Voltage, double Offset);
+    /// Hands the module's setpoints to worker's thread
+    void AddActuators(ActuatorWorker& worker)
+    {
+        worker.Add(m_driveTraffic.GetMailbox());
+        worker.Add(m_turnTraffic.GetMailbox());
+    }
 
-    // Convert any angle theta in radians to its equivalent on the interval [0, 2pi]
-    double ZeroTo2PiRads(double theta);
+private:
+    double VoltageToRadians(double voltage) const { return AngleMath::VoltageToRadians(voltage, DriveConstants::kTurnVoltageToRadians, m_offset); }
 
-    // Convert any angle theta in radians to its equivalent on the interval [-pi, pi]
-    double NegPiToPiRads(double theta);
+    // Sets the turn NEO encoder to the absolute angle when the module is still and the two
+    // have drifted apart, updating the sampled NEO position and the odometry's offset to the new frame
+    void ResyncTurnEncoder(double speed);
 
-    // Determine the smallest magnitude delta angle that can be added to initial angle that will 
-    // result in an angle equivalent (but not necessarily equal) to final angle. 
-    // All angles in radians
-    double MinTurnRads(double init, double final, bool& bOutputReverse);
+    // Fires the flight recorder on a current spike or a turn error that does not go away
+    void CheckFaults(double minTurnRads, double turnCurrent, double driveCurrent);
 
     // We have to use meters here instead of radians due to the fact that
     // ProfiledPIDController's constraints only take in meters per second and
@@ -216,22 +309,34 @@ private:
     double m_offset;
     std::string m_name;
 
-    CANSparkMax m_driveMotor;
-    CANSparkMax m_turningMotor;
+    typename Hw::Module m_hw;
 
-    CANPIDController m_drivePIDController = m_driveMotor.GetPIDController();
-    CANPIDController m_turnPIDController = m_turningMotor.GetPIDController();
+    using Traffic = SparkMaxTraffic<decltype(m_hw.m_driveMotor), decltype(m_hw.m_driveEncoder)>;
+    Traffic m_driveTraffic;
+    Traffic m_turnTraffic;
 
     DrivePidParams   m_drivePidParams;
     TurnPidParams   m_turnPidParams;
 
-    CANEncoder m_driveEncoder;
-    CANEncoder m_turnNeoEncoder = m_turningMotor.GetEncoder();
-    frc::AnalogInput m_turningEncoder;
+    SwerveModuleSample m_sample;
+    AbsoluteAngleFilter m_absAngleFilter;
+    double m_frameError = 0.0;              //!< Absolute angle less NEO position this loop, radians
+    double m_absAveragingWindow = 0.0;      //!< Seconds
+    std::atomic<double> m_neoToAbs{0.0};    //!< Absolute angle less NEO position at the last Sample, for ReadState
 
-    nt::NetworkTableEntry m_nteAbsEncTuningOffset;
+    Tunable* m_tuneOffset = nullptr;        //!< Absolute encoder offset slider
+    unsigned m_tunablesSeen = 0;
 
     using LogData = LogDataT<ESwerveModuleLogData>;
     LogData m_logData;
+    LogStatsT<ESwerveModuleLogData> m_logStats;     //!< Used instead of the raw samples when LogConstants::kAggregateModuleData is set
     Logger& m_log;
+    int m_logSiteId = -1;   //!< Registered on first use, one site per module
+
+    int m_stillLoops = 0;           //!< Loops the module has been still, for ResyncTurnEncoder
+    int m_turnErrorLoops = 0;
+    std::string m_currentFaultReason;
+    std::string m_turnFaultReason;
 };
+
+using SwerveModule = SwerveModuleT<Hardware>;
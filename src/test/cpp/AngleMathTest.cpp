@@ -0,0 +1,315 @@
+/*
+    AngleMath against the fmod helpers SwerveModule used before it, and the cost of both
+
+    The Reference namespace is the old code as it was, less a debug printf. Both are run over
+    a grid of edge angles and a few million random ones; results are compared as angles, i.e.
+    modulo 2pi, to a tolerance that grows with the input's magnitude.
+*/
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <wpi/math>
+
+#include "gtest/gtest.h"
+
+#include "AngleMath.h"
+#include "Benchmark.h"
+#include "Constants.h"
+
+namespace Reference
+{
+    double VoltageToRadians(double Voltage, double offset)
+    {
+        double angle = fmod(Voltage * DriveConstants::kTurnVoltageToRadians - offset + 2 * wpi::math::pi, 2 * wpi::math::pi);
+        angle = 2 * wpi::math::pi - angle;
+
+        return angle;
+    }
+
+    double VoltageToDegrees(double voltage, double offSet)
+    {
+        double angle = fmod(voltage * DriveConstants::KTurnVoltageToDegrees - offSet + 360.0, 360.0);
+
+        return angle;
+    }
+
+    // Convert any angle theta in radians to its equivalent on the interval [0, 2pi]
+    double ZeroTo2PiRads(double theta)
+    {
+        theta = fmod(theta, 2 * wpi::math::pi);
+        if (theta < 0)
+            theta += 2 * wpi::math::pi;
+
+        return theta;
+    }
+
+    // Convert any angle theta in radians to its equivalent on the interval [-pi, pi]
+    double NegPiToPiRads(double theta)
+    {
+        theta = ZeroTo2PiRads(theta);
+        if (theta > wpi::math::pi)
+            theta -= 2 * wpi::math::pi;
+        else if (theta < -1.0 * wpi::math::pi)
+            theta += 2 * wpi::math::pi;
+
+        return theta;
+    }
+
+    // Determine the smallest magnitude delta angle that can be added to initial angle that will
+    // result in an angle equivalent (but not necessarily equal) to final angle.
+    // All angles in radians
+    double MinTurnRads(double init, double final, bool& bOutputReverse)
+    {
+        init = ZeroTo2PiRads(init);
+        final = ZeroTo2PiRads(final);
+
+        // The shortest turn angle may be acheived by reversing the motor output direction
+        double angle1 = final - init;
+        double angle2 = final + wpi::math::pi - init;
+
+        angle1 = NegPiToPiRads(angle1);
+        angle2 = NegPiToPiRads(angle2);
+
+        // Choose the smallest angle and determine reverse flag
+        if (fabs(angle1) <= fabs(angle2))
+        {
+            bOutputReverse = false;
+            return angle1;
+        }
+        else
+        {
+            bOutputReverse = true;
+            return angle2;
+        }
+    }
+}
+
+namespace
+{
+    using AngleMath::c_pi;
+    using AngleMath::c_2pi;
+
+    constexpr size_t c_randomInputs = 2000000;
+
+    /// Rounding of a wrap grows with the number of turns taken off
+    double Tolerance(double theta)
+    {
+        return 1e-12 * std::max(1.0, std::fabs(theta));
+    }
+
+    /// a - b as an angle on [-pi, pi]
+    double AngleDiff(double a, double b)
+    {
+        return std::remainder(a - b, c_2pi);
+    }
+
+    /// Multiples of pi/4 out to 8 turns either way, their neighbours, and a few extremes
+    std::vector<double> EdgeAngles()
+    {
+        std::vector<double> angles = { 0.0, -0.0, 1e-300, -1e-300, 1e6, -1e6, 1e6 + 0.5, -1e6 - 0.5 };
+        for (int k = -64; k <= 64; k++)
+        {
+            double angle = k * c_pi / 4;
+            angles.push_back(angle);
+            angles.push_back(std::nextafter(angle, 1e9));
+            angles.push_back(std::nextafter(angle, -1e9));
+        }
+
+        return angles;
+    }
+
+    /// Edge angles followed by uniformly random ones on [-limit, limit]
+    std::vector<double> TestAngles(double limit, unsigned seed)
+    {
+        std::vector<double> angles = EdgeAngles();
+        std::mt19937_64 rng(seed);
+        std::uniform_real_distribution<double> dist(-limit, limit);
+        for (size_t i = 0; i < c_randomInputs; i++)
+        {
+            angles.push_back(dist(rng));
+        }
+
+        return angles;
+    }
+
+    /// True where rounding can legitimately tip the choice between the two turns
+    bool NearTie(double delta)
+    {
+        return std::fabs(std::fabs(delta) - c_pi / 2) < 1e-9;
+    }
+}
+
+TEST(AngleMathTest, ZeroTo2PiMatchesReference)
+{
+    for (double theta : TestAngles(1000.0, 1))
+    {
+        double wrapped = AngleMath::ZeroTo2Pi(theta);
+        ASSERT_GE(wrapped, -Tolerance(theta)) << theta;
+        ASSERT_LE(wrapped, c_2pi + Tolerance(theta)) << theta;
+        ASSERT_NEAR(0.0, AngleDiff(wrapped, Reference::ZeroTo2PiRads(theta)), Tolerance(theta)) << theta;
+    }
+}
+
+TEST(AngleMathTest, NegPiToPiMatchesReference)
+{
+    for (double theta : TestAngles(1000.0, 2))
+    {
+        double wrapped = AngleMath::NegPiToPi(theta);
+        ASSERT_GE(wrapped, -c_pi - Tolerance(theta)) << theta;
+        ASSERT_LE(wrapped, c_pi + Tolerance(theta)) << theta;
+        ASSERT_NEAR(0.0, AngleDiff(wrapped, Reference::NegPiToPiRads(theta)), Tolerance(theta)) << theta;
+    }
+}
+
+TEST(AngleMathTest, MinTurnRadsMatchesReference)
+{
+    std::vector<double> init = TestAngles(100.0, 3);
+    std::vector<double> final = TestAngles(100.0, 4);
+    std::rotate(final.begin(), final.begin() + 7, final.end());    // Pair edge angles with other edge angles
+
+    size_t ties = 0;
+    for (size_t i = 0; i < init.size(); i++)
+    {
+        bool bReverse;
+        bool bReferenceReverse;
+        double delta = AngleMath::MinTurnRads(init[i], final[i], bReverse);
+        double referenceDelta = Reference::MinTurnRads(init[i], final[i], bReferenceReverse);
+        double tolerance = Tolerance(init[i]) + Tolerance(final[i]);
+
+        // Never more than a quarter turn, and it lands on final, or final's opposite when reversed
+        ASSERT_LE(std::fabs(delta), c_pi / 2 + tolerance) << init[i] << " " << final[i];
+        ASSERT_NEAR(0.0, AngleDiff(init[i] + delta, final[i] + (bReverse ? c_pi : 0.0)), tolerance) << init[i] << " " << final[i];
+
+        if (NearTie(referenceDelta))
+        {
+            ties++;
+            continue;
+        }
+        ASSERT_EQ(bReferenceReverse, bReverse) << init[i] << " " << final[i];
+        ASSERT_NEAR(referenceDelta, delta, tolerance) << init[i] << " " << final[i];
+    }
+
+    // The edge grid has exact quarter turns, the random inputs next to none
+    EXPECT_LT(ties, init.size() / 1000);
+}
+
+TEST(AngleMathTest, VoltageToRadiansMatchesReference)
+{
+    std::mt19937_64 rng(5);
+    std::uniform_real_distribution<double> volts(0.0, 4.93);
+    std::uniform_real_distribution<double> offset(0.0, c_2pi);
+
+    for (size_t i = 0; i < c_randomInputs; i++)
+    {
+        double v = volts(rng);
+        double o = offset(rng);
+        double angle = AngleMath::VoltageToRadians(v, DriveConstants::kTurnVoltageToRadians, o);
+        ASSERT_GT(angle, 0.0) << v << " " << o;
+        ASSERT_LE(angle, c_2pi) << v << " " << o;
+        ASSERT_NEAR(0.0, AngleDiff(angle, Reference::VoltageToRadians(v, o)), 1e-12) << v << " " << o;
+    }
+}
+
+TEST(AngleMathTest, VoltageToDegreesMatchesReference)
+{
+    std::mt19937_64 rng(6);
+    std::uniform_real_distribution<double> volts(0.0, 4.93);
+    std::uniform_real_distribution<double> offset(0.0, 360.0);
+
+    for (size_t i = 0; i < c_randomInputs; i++)
+    {
+        double v = volts(rng);
+        double o = offset(rng);
+        double angle = AngleMath::VoltageToDegrees(v, DriveConstants::KTurnVoltageToDegrees, o);
+        ASSERT_GE(angle, 0.0) << v << " " << o;
+        ASSERT_LT(angle, 360.0) << v << " " << o;
+        ASSERT_NEAR(0.0, std::remainder(angle - Reference::VoltageToDegrees(v, o), 360.0), 1e-10) << v << " " << o;
+    }
+}
+
+TEST(AngleMathTest, BatchMatchesScalar)
+{
+    std::vector<double> angles = TestAngles(100.0, 7);
+    for (size_t i = 0; i + 8 <= angles.size(); i += 8)
+    {
+        std::array<double, 4> init = { angles[i], angles[i + 1], angles[i + 2], angles[i + 3] };
+        std::array<double, 4> final = { angles[i + 4], angles[i + 5], angles[i + 6], angles[i + 7] };
+        std::array<double, 4> delta;
+        std::array<bool, 4> bReverse;
+        AngleMath::MinTurnRads(init, final, delta, bReverse);
+
+        std::array<double, 4> volts = { std::fabs(init[0]), std::fabs(init[1]), std::fabs(init[2]), std::fabs(init[3]) };
+        std::array<double, 4> radians;
+        AngleMath::VoltageToRadians(volts, DriveConstants::kTurnVoltageToRadians, final, radians);
+
+        for (size_t m = 0; m < 4; m++)
+        {
+            bool bScalarReverse;
+            ASSERT_EQ(AngleMath::MinTurnRads(init[m], final[m], bScalarReverse), delta[m]);
+            ASSERT_EQ(bScalarReverse, bReverse[m]);
+            ASSERT_EQ(AngleMath::VoltageToRadians(volts[m], DriveConstants::kTurnVoltageToRadians, final[m]), radians[m]);
+        }
+    }
+}
+
+TEST(DISABLED_AngleMathBenchmark, AgainstReference)
+{
+    constexpr size_t c_iterations = 4000000;
+    constexpr size_t c_mask = 4095;
+    std::vector<double> angles(c_mask + 1);
+    std::mt19937_64 rng(8);
+    std::uniform_real_distribution<double> dist(-10.0, 10.0);
+    for (double& angle : angles)
+    {
+        angle = dist(rng);
+    }
+
+    double sum = 0.0;
+    bool bReverse;
+
+    Benchmark::Report("Reference::NegPiToPiRads", Benchmark::NsPerCall(c_iterations, [&](size_t i)
+    {
+        sum += Reference::NegPiToPiRads(angles[i & c_mask]);
+    }));
+    Benchmark::Report("AngleMath::NegPiToPi", Benchmark::NsPerCall(c_iterations, [&](size_t i)
+    {
+        sum += AngleMath::NegPiToPi(angles[i & c_mask]);
+    }));
+
+    Benchmark::Report("Reference::MinTurnRads", Benchmark::NsPerCall(c_iterations, [&](size_t i)
+    {
+        sum += Reference::MinTurnRads(angles[i & c_mask], angles[(i + 1) & c_mask], bReverse);
+        sum += bReverse;
+    }));
+    Benchmark::Report("AngleMath::MinTurnRads", Benchmark::NsPerCall(c_iterations, [&](size_t i)
+    {
+        sum += AngleMath::MinTurnRads(angles[i & c_mask], angles[(i + 1) & c_mask], bReverse);
+        sum += bReverse;
+    }));
+
+    std::array<double, 4> delta;
+    std::array<bool, 4> bReverses;
+    Benchmark::Report("AngleMath::MinTurnRads, 4 modules", Benchmark::NsPerCall(c_iterations / 4, [&](size_t i)
+    {
+        size_t first = (i * 8) & c_mask;
+        std::array<double, 4> init = { angles[first], angles[first + 1], angles[first + 2], angles[first + 3] };
+        std::array<double, 4> final = { angles[first + 4], angles[first + 5], angles[first + 6], angles[first + 7] };
+        AngleMath::MinTurnRads(init, final, delta, bReverses);
+        sum += delta[0] + delta[1] + delta[2] + delta[3];
+    }));
+
+    Benchmark::Report("Reference::VoltageToRadians", Benchmark::NsPerCall(c_iterations, [&](size_t i)
+    {
+        sum += Reference::VoltageToRadians(std::fabs(angles[i & c_mask]) * 0.49, 1.0);
+    }));
+    Benchmark::Report("AngleMath::VoltageToRadians", Benchmark::NsPerCall(c_iterations, [&](size_t i)
+    {
+        sum += AngleMath::VoltageToRadians(std::fabs(angles[i & c_mask]) * 0.49, DriveConstants::kTurnVoltageToRadians, 1.0);
+    }));
+
+    Benchmark::DoNotOptimize(sum);
+}
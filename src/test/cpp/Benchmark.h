@@ -0,0 +1,87 @@
+/*
+    Timing helpers for the benchmark tests
+
+    The benchmarks print their numbers and assert nothing about them, so a slow or busy build
+    machine never fails the suite. They are DISABLED_ so a normal build does not spend time on
+    them; run them with --gtest_also_run_disabled_tests --gtest_filter=*Benchmark*.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+namespace Benchmark
+{
+    using Clock = std::chrono::steady_clock;
+
+    /// Keeps the compiler from dropping a result nothing else reads
+    template <typename T>
+    inline void DoNotOptimize(const T& value)
+    {
+#if defined(__GNUC__)
+        asm volatile("" : : "g"(&value) : "memory");
+#else
+        static const void* volatile s_sink;
+        s_sink = &value;
+#endif
+    }
+
+    /// Mean nanoseconds per call of f(i) for i on [0, iterations)
+    template <typename F>
+    double NsPerCall(size_t iterations, F&& f)
+    {
+        auto start = Clock::now();
+        for (size_t i = 0; i < iterations; i++)
+        {
+            f(i);
+        }
+        auto end = Clock::now();
+
+        return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+    }
+
+    /// Nanoseconds of each call of f(i) timed on its own, sorted for Percentile.
+    /// between(i) runs untimed after each call, e.g. to pace the calls like the robot loop.
+    template <typename F, typename G>
+    std::vector<double> CallLatencies(size_t iterations, F&& f, G&& between)
+    {
+        std::vector<double> latencies(iterations);
+        for (size_t i = 0; i < iterations; i++)
+        {
+            auto start = Clock::now();
+            f(i);
+            auto end = Clock::now();
+            latencies[i] = std::chrono::duration<double, std::nano>(end - start).count();
+            between(i);
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        return latencies;
+    }
+
+    template <typename F>
+    std::vector<double> CallLatencies(size_t iterations, F&& f)
+    {
+        return CallLatencies(iterations, f, [](size_t) {});
+    }
+
+    /// p on [0, 1] of sorted latencies
+    inline double Percentile(const std::vector<double>& sorted, double p)
+    {
+        return sorted.empty() ? 0.0 : sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+    }
+
+    inline void Report(const char* name, double ns)
+    {
+        printf("[  BENCH   ] %-48s %10.1f ns\n", name, ns);
+    }
+
+    inline void Report(const char* name, const std::vector<double>& sorted)
+    {
+        printf("[  BENCH   ] %-48s p50 %10.1f ns  p99 %10.1f ns\n", name, Percentile(sorted, 0.5), Percentile(sorted, 0.99));
+    }
+}
@@ -0,0 +1,123 @@
+/*
+    Batch runs of the simulated drivetrain
+
+    Runs DriveSubsystemT<SimHardware> the way the robot loop does, Periodic and then the
+    command's Drive, with nothing in between. DrivetrainSim only moves when Periodic steps it,
+    so a run goes as fast as the host can call the loop and comes out the same every time:
+    controller gains and trajectories can be swept headless, many runs per second of wall time.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+
+#include <frc/geometry/Pose2d.h>
+#include <frc2/command/CommandScheduler.h>
+
+#include "AngleMath.h"
+#include "Constants.h"
+#include "ScratchLogger.h"
+#include "hardware/DrivetrainSim.h"
+#include "hardware/SimHardware.h"
+#include "subsystems/DriveSubsystem.h"
+
+class DriveSimHarness
+{
+public:
+    using Drive = DriveSubsystemT<SimHardware>;
+
+    /// Called once per loop after Periodic, in place of the scheduled command
+    /// @param time     Sim time of the loop, seconds
+    using Command = std::function<void(Drive& drive, double time)>;
+
+    /// Gains of one Spark MAX position or velocity loop, in encoder units
+    struct Gains
+    {
+        double m_p;
+        double m_i;
+        double m_d;
+        double m_ff;
+    };
+
+    DriveSimHarness()
+        : m_drive(m_log.Get())
+    {
+    }
+
+    ~DriveSimHarness()
+    {
+        frc2::CommandScheduler::GetInstance().UnregisterSubsystem(&m_drive);
+    }
+
+    Drive& GetDrive() { return m_drive; }
+    const DrivetrainSim::State& GetTrueState() { return m_drive.GetWorld().GetState(); }
+    double GetTime() { return m_drive.GetWorld().GetTime(); }
+
+    /// Sets every module's turn loop, until the dashboard changes it
+    void SetTurnGains(const Gains& gains)
+    {
+        for (SimModuleHardware* module : m_drive.GetModuleHardware())
+        {
+            SetGains(module->m_turnMotor, gains);
+        }
+    }
+
+    /// Sets every module's drive loop, until the dashboard changes it
+    void SetDriveGains(const Gains& gains)
+    {
+        for (SimModuleHardware* module : m_drive.GetModuleHardware())
+        {
+            SetGains(module->m_driveMotor, gains);
+        }
+    }
+
+    /// Runs loops robot loops of command. The largest distance between the odometry and the
+    /// true position seen at the end of a loop is kept for GetMaxPoseError.
+    void Run(int loops, const Command& command)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < loops; i++)
+        {
+            m_drive.Periodic();
+            command(m_drive, GetTime());
+            m_maxPoseError = std::max(m_maxPoseError, GetPoseError());
+        }
+        m_wallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /// Meters between the odometry and the true position
+    double GetPoseError()
+    {
+        frc::Pose2d pose = m_drive.GetPose();
+        const DrivetrainSim::State& state = GetTrueState();
+        return std::hypot(pose.Translation().X().to<double>() - state.m_x, pose.Translation().Y().to<double>() - state.m_y);
+    }
+
+    /// Radians between the odometry and the true heading
+    double GetHeadingError()
+    {
+        return AngleMath::NegPiToPi(m_drive.GetPose().Rotation().Radians().to<double>() - GetTrueState().m_heading);
+    }
+
+    double GetMaxPoseError() const { return m_maxPoseError; }
+
+    /// Sim seconds run per wall clock second so far
+    double GetSpeedup() { return m_wallSeconds > 0.0 ? GetTime() / m_wallSeconds : 0.0; }
+
+private:
+    static void SetGains(SimMotor& motor, const Gains& gains)
+    {
+        motor.SetP(gains.m_p);
+        motor.SetI(gains.m_i);
+        motor.SetD(gains.m_d);
+        motor.SetFF(gains.m_ff);
+    }
+
+    ScratchLogger m_log;
+    Drive m_drive;
+    double m_maxPoseError = 0.0;
+    double m_wallSeconds = 0.0;
+};
@@ -0,0 +1,226 @@
+/*
+    DriveSubsystemT<SimHardware> run headless through DriveSimHarness: odometry against the
+    simulation's true pose on straight, curved and field relative drives and on a trajectory,
+    then sweeps of the turn loop gain and the trajectory path gain
+
+    The sweeps print what each setting did and assert nothing about it, like the benchmarks, and
+    are disabled the same way. Run them with
+    --gtest_also_run_disabled_tests --gtest_filter=*DriveSimSweep.*
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <frc/geometry/Pose2d.h>
+#include <frc/geometry/Rotation2d.h>
+#include <frc/geometry/Translation2d.h>
+#include <frc/trajectory/Trajectory.h>
+#include <frc/trajectory/TrajectoryConfig.h>
+#include <frc/trajectory/TrajectoryGenerator.h>
+
+#include "gtest/gtest.h"
+
+#include "AngleMath.h"
+#include "Constants.h"
+#include "DriveSimHarness.h"
+
+namespace
+{
+    using Drive = DriveSimHarness::Drive;
+
+    constexpr int c_loopsPerSecond = static_cast<int>(LogConstants::kLoopsPerSecond);
+
+    // Turn loop gains that keep the wheels on a moving target. With the default P of 0.1 the
+    // wheels stop about 0.11 rad short against steering friction (see DISABLED_DriveSimSweep.TurnGain),
+    // which on curved paths is a heading or path error of its own rather than odometry error.
+    constexpr DriveSimHarness::Gains c_stiffTurnGains = { 0.8, 0.0, 1.0, 0.0 };
+
+    DriveSimHarness::Command Constant(double xSpeed, double ySpeed, double rot, bool bFieldRelative)
+    {
+        return [=](Drive& drive, double)
+        {
+            drive.Drive(units::meters_per_second_t(xSpeed), units::meters_per_second_t(ySpeed), units::radians_per_second_t(rot), bFieldRelative);
+        };
+    }
+
+    /// RobotContainer's 's' curve, 3 m ahead through (1, 1) and (2, -1), with its config
+    frc::Trajectory MakeSCurve(Drive& drive)
+    {
+        frc::TrajectoryConfig config(AutoConstants::kMaxSpeed, AutoConstants::kMaxAcceleration);
+        config.SetKinematics(drive.kDriveKinematics);
+
+        return frc::TrajectoryGenerator::GenerateTrajectory(
+              frc::Pose2d(units::meter_t(0.0), units::meter_t(0.0), frc::Rotation2d(units::radian_t(0.0)))
+            , { frc::Translation2d(units::meter_t(1.0), units::meter_t(1.0)), frc::Translation2d(units::meter_t(2.0), units::meter_t(-1.0)) }
+            , frc::Pose2d(units::meter_t(3.0), units::meter_t(0.0), frc::Rotation2d(units::radian_t(0.0)))
+            , config);
+    }
+
+    /// Result of following a trajectory
+    struct FollowResult
+    {
+        double m_maxTrackingError = 0.0;    //!< Largest distance from the true position to the trajectory's, meters
+        double m_endError = 0.0;            //!< Distance from the true position to the trajectory's end after it, meters
+    };
+
+    /// Follows trajectory the way SwerveControllerCommand does, on the sim clock: the
+    /// trajectory's velocity along its heading plus pathGain times the position error from the
+    /// odometry, and kPThetaController on the heading error to the final heading. Then stops
+    /// for a second.
+    FollowResult Follow(DriveSimHarness& harness, const frc::Trajectory& trajectory, double pathGain)
+    {
+        FollowResult result;
+        double start = harness.GetTime();
+        double finalHeading = trajectory.States().back().pose.Rotation().Radians().to<double>();
+        int loops = static_cast<int>(std::ceil(trajectory.TotalTime().to<double>() * c_loopsPerSecond)) + 1;
+
+        harness.Run(loops, [&](Drive& drive, double time)
+        {
+            frc::Trajectory::State desired = trajectory.Sample(units::second_t(time - start));
+            double x = desired.pose.Translation().X().to<double>();
+            double y = desired.pose.Translation().Y().to<double>();
+            double heading = desired.pose.Rotation().Radians().to<double>();
+            double velocity = desired.velocity.to<double>();
+
+            const DrivetrainSim::State& state = harness.GetTrueState();
+            result.m_maxTrackingError = std::max(result.m_maxTrackingError, std::hypot(x - state.m_x, y - state.m_y));
+
+            frc::Pose2d pose = drive.GetPose();
+            double xSpeed = velocity * cos(heading) + pathGain * (x - pose.Translation().X().to<double>());
+            double ySpeed = velocity * sin(heading) + pathGain * (y - pose.Translation().Y().to<double>());
+            double rot = AutoConstants::kPThetaController * AngleMath::NegPiToPi(finalHeading - pose.Rotation().Radians().to<double>());
+            drive.Drive(units::meters_per_second_t(xSpeed), units::meters_per_second_t(ySpeed), units::radians_per_second_t(rot), true);
+        });
+        harness.Run(c_loopsPerSecond, Constant(0.0, 0.0, 0.0, false));
+
+        const frc::Translation2d& end = trajectory.States().back().pose.Translation();
+        const DrivetrainSim::State& state = harness.GetTrueState();
+        result.m_endError = std::hypot(end.X().to<double>() - state.m_x, end.Y().to<double>() - state.m_y);
+
+        return result;
+    }
+
+    /// First loop from which the error stays within tolerance, or -1
+    int TurnSettleLoops(const std::vector<double>& errors, double tolerance)
+    {
+        int settled = -1;
+        for (size_t i = 0; i < errors.size(); i++)
+        {
+            if (errors[i] > tolerance)
+            {
+                settled = -1;
+            }
+            else if (settled < 0)
+            {
+                settled = static_cast<int>(i);
+            }
+        }
+        return settled;
+    }
+
+    /// Largest error of the true wheel angles from angle, a half turn with the drive reversed counting as none
+    double MaxTurnError(Drive& drive, double angle)
+    {
+        double maxError = 0.0;
+        for (SimModuleHardware* module : drive.GetModuleHardware())
+        {
+            bool bOutputReverse;
+            maxError = std::max(maxError, fabs(AngleMath::MinTurnRads(module->m_absEncoder.GetWheelAngle(), angle, bOutputReverse)));
+        }
+        return maxError;
+    }
+}
+
+TEST(DriveSimTest, StraightLine)
+{
+    DriveSimHarness harness;
+    harness.Run(3 * c_loopsPerSecond, Constant(0.5, 0.0, 0.0, false));
+    harness.Run(c_loopsPerSecond, Constant(0.0, 0.0, 0.0, false));
+
+    const DrivetrainSim::State& state = harness.GetTrueState();
+    EXPECT_NEAR(1.5, state.m_x, 0.25);
+    EXPECT_NEAR(0.0, state.m_y, 0.05);
+    EXPECT_NEAR(0.0, state.m_heading, 0.02);
+    EXPECT_LT(harness.GetMaxPoseError(), 0.05);
+    EXPECT_NEAR(0.0, harness.GetHeadingError(), 0.01);
+}
+
+TEST(DriveSimTest, CircleComesBackToTheStart)
+{
+    // Forward while turning, one full circle of 1 m radius
+    DriveSimHarness harness;
+    harness.SetTurnGains(c_stiffTurnGains);
+    harness.Run(static_cast<int>(AngleMath::c_2pi / 0.5 * c_loopsPerSecond), Constant(0.5, 0.0, 0.5, false));
+    harness.Run(c_loopsPerSecond, Constant(0.0, 0.0, 0.0, false));
+
+    const DrivetrainSim::State& state = harness.GetTrueState();
+    EXPECT_NEAR(AngleMath::c_2pi, state.m_heading, 0.3);
+    EXPECT_LT(std::hypot(state.m_x, state.m_y), 0.3);
+    EXPECT_LT(harness.GetMaxPoseError(), 0.1);
+    EXPECT_NEAR(0.0, harness.GetHeadingError(), 0.01);
+}
+
+TEST(DriveSimTest, FieldRelativeWhileSpinning)
+{
+    // The chassis spins under the wheels, the path on the field stays straight along x
+    DriveSimHarness harness;
+    harness.SetTurnGains(c_stiffTurnGains);
+    harness.Run(4 * c_loopsPerSecond, Constant(0.5, 0.0, 1.0, true));
+    harness.Run(c_loopsPerSecond, Constant(0.0, 0.0, 0.0, false));
+
+    const DrivetrainSim::State& state = harness.GetTrueState();
+    EXPECT_GT(state.m_x, 1.0);
+    EXPECT_NEAR(0.0, atan2(state.m_y, state.m_x), 0.2);
+    EXPECT_GT(state.m_heading, 2.0);
+    EXPECT_LT(harness.GetMaxPoseError(), 0.1);
+    EXPECT_NEAR(0.0, harness.GetHeadingError(), 0.01);
+}
+
+TEST(DriveSimTest, FollowsTrajectory)
+{
+    DriveSimHarness harness;
+    harness.SetTurnGains(c_stiffTurnGains);
+    FollowResult result = Follow(harness, MakeSCurve(harness.GetDrive()), AutoConstants::kPXController);
+
+    EXPECT_LT(result.m_maxTrackingError, 0.3);
+    EXPECT_LT(result.m_endError, 0.15);
+    EXPECT_LT(harness.GetMaxPoseError(), 0.1);
+    printf("[  SIM     ] %.1f s of sim in %.3f s, %.0fx real time\n", harness.GetTime(), harness.GetTime() / harness.GetSpeedup(), harness.GetSpeedup());
+}
+
+TEST(DISABLED_DriveSimSweep, TurnGain)
+{
+    // A quarter turn from rest to strafing, with the default D gain and no I
+    constexpr double c_angle = AngleMath::c_pi / 2;
+    constexpr double c_tolerance = 0.05;
+    for (double p : { 0.05, 0.1, 0.2, 0.4, 0.8, 1.6 })
+    {
+        DriveSimHarness harness;
+        harness.SetTurnGains({ p, 0.0, 1.0, 0.0 });
+
+        std::vector<double> errors;
+        harness.Run(2 * c_loopsPerSecond, [&](Drive& drive, double time)
+        {
+            Constant(0.0, 0.3, 0.0, false)(drive, time);
+            errors.push_back(MaxTurnError(drive, c_angle));
+        });
+
+        int settle = TurnSettleLoops(errors, c_tolerance);
+        printf("[  SWEEP   ] turn P %-5.2f within %.2f rad after %5.2f s, final error %.3f rad\n"
+              , p, c_tolerance, settle < 0 ? NAN : settle / LogConstants::kLoopsPerSecond, errors.back());
+    }
+}
+
+TEST(DISABLED_DriveSimSweep, TrajectoryPathGain)
+{
+    for (double pathGain : { 0.0, 0.25, 0.5, 1.0, 2.0, 4.0 })
+    {
+        DriveSimHarness harness;
+        harness.SetTurnGains(c_stiffTurnGains);
+        FollowResult result = Follow(harness, MakeSCurve(harness.GetDrive()), pathGain);
+        printf("[  SWEEP   ] path P %-5.2f max tracking error %.3f m, end error %.3f m, odometry error %.3f m\n"
+              , pathGain, result.m_maxTrackingError, result.m_endError, harness.GetMaxPoseError());
+    }
+}
@@ -0,0 +1,540 @@
+/*
+    Logger: async messages longer than one ring record, LogStatsT summaries in the binary sink,
+    flight recorder windows and fault files against the disk budget, func/line sites looked up
+    while other threads register, and the per call cost of logMsg in async and sync mode
+*/
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Benchmark.h"
+#include "Logger.h"
+#include "TempDirectory.h"
+
+enum class ELoggerTestData : int
+{
+      eFirstInt
+    , eLastInt = eFirstInt
+
+    , eFirstDouble
+    , eA = eFirstDouble
+    , eB
+    , eC
+    , eD
+    , eE
+    , eF
+    , eG
+    , eH
+    , eI
+    , eJ
+    , eLastDouble
+};
+
+template <>
+struct LogDataSchema<ELoggerTestData>
+{
+    static constexpr LogField<ELoggerTestData> c_fields[] =
+    {
+          { ELoggerTestData::eA, "a" }
+        , { ELoggerTestData::eB, "b" }
+        , { ELoggerTestData::eC, "c" }
+        , { ELoggerTestData::eD, "d" }
+        , { ELoggerTestData::eE, "e" }
+        , { ELoggerTestData::eF, "f" }
+        , { ELoggerTestData::eG, "g" }
+        , { ELoggerTestData::eH, "h" }
+        , { ELoggerTestData::eI, "i" }
+        , { ELoggerTestData::eJ, "j" }
+    };
+};
+
+namespace
+{
+    class LoggerTest : public ::testing::Test
+    {
+    protected:
+        void SetUp() override
+        {
+            NewDirectory();
+        }
+
+        /// Moves m_config to a new empty log directory, removing the old one
+        void NewDirectory()
+        {
+            m_directory = std::make_unique<TempDirectory>();
+            ASSERT_FALSE(m_directory->GetPath().empty());
+            m_config.m_directory = m_directory->GetPath();
+        }
+
+        std::vector<std::string> Files() const
+        {
+            return m_directory->GetFiles();
+        }
+
+        /// Every line of the CSV files
+        std::vector<std::string> CsvLines() const
+        {
+            std::vector<std::string> lines;
+            for (const std::string& path : Files())
+            {
+                if (path.size() < 4 || path.compare(path.size() - 4, 4, ".csv") != 0)
+                {
+                    continue;
+                }
+
+                std::ifstream file(path);
+                std::string line;
+                while (std::getline(file, line))
+                {
+                    lines.push_back(line);
+                }
+            }
+            return lines;
+        }
+
+        /// Message column of every log line (not site table or header rows) of the one CSV file
+        std::vector<std::string> Messages() const
+        {
+            std::vector<std::string> messages;
+            for (const std::string& line : CsvLines())
+            {
+                if (line.empty() || line[0] < '0' || line[0] > '9')
+                {
+                    continue;
+                }
+                // Timestamp,Level,Site,Message
+                size_t start = 0;
+                for (int comma = 0; comma < 3 && start != std::string::npos; comma++)
+                {
+                    start = line.find(',', start);
+                    start = start == std::string::npos ? start : start + 1;
+                }
+                messages.push_back(start == std::string::npos ? std::string() : line.substr(start));
+            }
+            return messages;
+        }
+
+        /// Appends the int fields of every record of the named stream in the files ending in suffix to records
+        void ReadBinaryInts(const std::string& streamName, std::vector<std::vector<int32_t>>& records, const std::string& suffix = ".bin") const
+        {
+            for (const std::string& path : Files())
+            {
+                if (path.size() < suffix.size() || path.compare(path.size() - suffix.size(), suffix.size(), suffix) != 0)
+                {
+                    continue;
+                }
+
+                std::ifstream file(path, std::ios::binary);
+                std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+                size_t pos = 0;
+                auto read = [&](void* out, size_t size)
+                {
+                    bool bOk = pos + size <= bytes.size();
+                    if (bOk)
+                    {
+                        memcpy(out, &bytes[pos], size);
+                        pos += size;
+                    }
+                    return bOk;
+                };
+                auto readString = [&](std::string& out)
+                {
+                    uint16_t length;
+                    bool bOk = read(&length, sizeof(length)) && pos + length <= bytes.size();
+                    if (bOk)
+                    {
+                        out.assign(&bytes[pos], length);
+                        pos += length;
+                    }
+                    return bOk;
+                };
+
+                // Per segment stream id to (wanted, ints, doubles)
+                struct Stream { bool m_bWanted = false; uint16_t m_numInts = 0; uint16_t m_numDoubles = 0; };
+                std::vector<Stream> streams;
+                char magic[sizeof(BinaryLog::c_magic)];
+                while (pos < bytes.size())
+                {
+                    if (bytes[pos] == BinaryLog::c_magic[0])
+                    {
+                        uint32_t version;
+                        ASSERT_TRUE(read(magic, sizeof(magic)) && read(&version, sizeof(version))) << path;
+                        ASSERT_EQ(0, memcmp(magic, BinaryLog::c_magic, sizeof(magic))) << path;
+                        streams.clear();
+                        continue;
+                    }
+
+                    uint8_t tag;
+                    uint16_t id;
+                    ASSERT_TRUE(read(&tag, sizeof(tag)) && read(&id, sizeof(id))) << path;
+                    if (id >= streams.size())
+                    {
+                        streams.resize(id + 1);
+                    }
+                    Stream& stream = streams[id];
+
+                    if (tag == BinaryLog::c_tagSchema)
+                    {
+                        std::string name;
+                        ASSERT_TRUE(read(&stream.m_numInts, sizeof(uint16_t)) && read(&stream.m_numDoubles, sizeof(uint16_t)) && readString(name)) << path;
+                        for (int i = 0; i < stream.m_numInts + stream.m_numDoubles; i++)
+                        {
+                            std::string fieldName;
+                            ASSERT_TRUE(readString(fieldName)) << path;
+                        }
+                        stream.m_bWanted = name == streamName;
+                        continue;
+                    }
+
+                    ASSERT_EQ(BinaryLog::c_tagRecord, tag) << path;
+                    int64_t timestampUs;
+                    std::vector<int32_t> ints(stream.m_numInts);
+                    std::vector<double> doubles(stream.m_numDoubles);
+                    ASSERT_TRUE(read(&timestampUs, sizeof(timestampUs))
+                             && read(ints.data(), ints.size() * sizeof(int32_t))
+                             && read(doubles.data(), doubles.size() * sizeof(double))) << path;
+                    if (stream.m_bWanted)
+                    {
+                        records.push_back(ints);
+                    }
+                }
+            }
+        }
+
+        /// Logs msg, msg2 pairs of these lengths through a fresh logger and returns the message column
+        std::vector<std::string> LogPairs(bool bAsync, const std::vector<std::pair<size_t, size_t>>& lengths)
+        {
+            {
+                Logger logger(m_config, false, bAsync);
+                int site = logger.RegisterSite("LoggerTest", __LINE__);
+                logger.openLog("test");
+                for (const auto& length : lengths)
+                {
+                    std::string msg = Text(length.first, 'a');
+                    if (length.second == 0)
+                    {
+                        logger.logMsg(eInfo, site, msg.c_str());
+                    }
+                    else
+                    {
+                        logger.logMsg(eInfo, site, msg.c_str(), Text(length.second, 'A').c_str());
+                    }
+                }
+                logger.closeLog();
+                m_splitRecords = logger.GetSplitRecords();
+                m_droppedRecords = logger.GetDroppedRecords();
+            }
+
+            return Messages();
+        }
+
+        /// length characters cycling from first, so a lost or repeated chunk shows
+        static std::string Text(size_t length, char first)
+        {
+            std::string text(length, ' ');
+            for (size_t i = 0; i < length; i++)
+            {
+                text[i] = first + i % 26;
+            }
+            return text;
+        }
+
+        /// Total size of the files in the log directory
+        uint64_t DirectorySize() const
+        {
+            uint64_t size = 0;
+            for (const std::string& path : Files())
+            {
+                struct stat st;
+                size += stat(path.c_str(), &st) == 0 ? st.st_size : 0;
+            }
+            return size;
+        }
+
+        std::unique_ptr<TempDirectory> m_directory;
+        LogStorage::Config m_config;
+        uint32_t m_splitRecords = 0;
+        uint32_t m_droppedRecords = 0;
+    };
+
+    constexpr size_t c_msgSize = LogRecord::c_msgSize;
+}
+
+TEST_F(LoggerTest, AsyncLongMessagesAreWhole)
+{
+    const std::vector<std::pair<size_t, size_t>> lengths =
+    {
+          { 10, 0 }
+        , { c_msgSize - 1, 0 }          // Fits with its terminator
+        , { c_msgSize, 0 }              // One char too many
+        , { c_msgSize + 1, 0 }
+        , { 3 * c_msgSize + 17, 0 }
+        , { c_msgSize - 2, 5 }          // The comma lands on the last char
+        , { c_msgSize - 1, 5 }          // The comma starts the second record
+        , { 600, 800 }                  // A wide logData row, ints then doubles
+        , { 0, 0 }
+    };
+
+    std::vector<std::string> messages = LogPairs(true, lengths);
+    ASSERT_EQ(lengths.size(), messages.size());
+    for (size_t i = 0; i < lengths.size(); i++)
+    {
+        std::string expected = Text(lengths[i].first, 'a');
+        if (lengths[i].second != 0)
+        {
+            expected += "," + Text(lengths[i].second, 'A');
+        }
+        EXPECT_EQ(expected, messages[i]) << "message " << i;
+    }
+
+    EXPECT_EQ(6u, m_splitRecords);
+    EXPECT_EQ(0u, m_droppedRecords);
+}
+
+TEST_F(LoggerTest, AsyncMatchesSync)
+{
+    const std::vector<std::pair<size_t, size_t>> lengths = { { 5, 0 }, { 2000, 0 }, { 300, 300 }, { 12, 7 } };
+
+    std::vector<std::string> async = LogPairs(true, lengths);
+    NewDirectory();
+    std::vector<std::string> sync = LogPairs(false, lengths);
+
+    EXPECT_EQ(sync, async);
+}
+
+TEST_F(LoggerTest, BinaryStatsKeepEveryField)
+{
+    // Summaries are logged back to back, one per field. Decimating them like raw samples would keep
+    // only fields 0 and 5 of a ten field stream, so every one has to reach the file.
+    constexpr double c_windowSeconds = 0.01;
+    constexpr size_t c_numFields = LogStatsT<ELoggerTestData>::c_numFields;
+    for (bool bAsync : { false, true })
+    {
+        {
+            Logger logger(m_config, false, bAsync, true);
+            logger.SetFlightRecorder(1.0, 50.0, 5);
+            int site = logger.RegisterSite("LoggerTest", __LINE__);
+            logger.openLog("stats");
+
+            LogDataT<ELoggerTestData> data(false, "");
+            LogStatsT<ELoggerTestData> stats(c_windowSeconds);
+            for (int i = 0; i < 100; i++)
+            {
+                data[ELoggerTestData::eA] = i;
+                logger.logStats(site, data, stats);
+                logger.logData(site, data);
+                usleep(1000);
+            }
+            logger.closeLog();
+            EXPECT_EQ(0u, logger.GetDroppedRecords());
+        }
+
+        std::vector<std::vector<int32_t>> records;
+        ReadBinaryInts("LoggerTest stats", records);
+        ASSERT_GE(records.size(), 2 * c_numFields) << (bAsync ? "async" : "sync");
+        ASSERT_EQ(0u, records.size() % c_numFields) << (bAsync ? "async" : "sync");
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            // field, count
+            ASSERT_EQ(2u, records[i].size());
+            EXPECT_EQ(static_cast<int>(i % c_numFields), records[i][0]) << "record " << i;
+            EXPECT_GT(records[i][1], 0) << "record " << i;
+        }
+
+        NewDirectory();
+    }
+}
+
+TEST_F(LoggerTest, FlightRecorderWindowPerStream)
+{
+    // One stream logged at 4 times the default rate, one at the default. Each fault file window
+    // holds the same time of both.
+    constexpr double c_windowSeconds = 1.0;
+    constexpr double c_defaultRate = 50.0;
+    constexpr double c_fastRate = 4 * c_defaultRate;
+    {
+        Logger logger(m_config, false, false, true);
+        logger.SetFlightRecorder(c_windowSeconds, c_defaultRate, 5);
+        int fastSite = logger.RegisterSite("Fast", __LINE__);
+        int slowSite = logger.RegisterSite("Slow", __LINE__);
+        logger.openLog("window");
+
+        LogDataT<ELoggerTestData> fast(false, "", c_fastRate);
+        LogDataT<ELoggerTestData> slow(false, "");
+        for (int i = 0; i < 2 * c_fastRate * c_windowSeconds; i++)
+        {
+            logger.logData(fastSite, fast);
+            if (i % 4 == 0)
+            {
+                logger.logData(slowSite, slow);
+            }
+        }
+        logger.TriggerFlightRecorder("test");
+        logger.closeLog();
+    }
+
+    std::vector<std::vector<int32_t>> fast;
+    std::vector<std::vector<int32_t>> slow;
+    ReadBinaryInts("Fast", fast, "_fault.bin");
+    ReadBinaryInts("Slow", slow, "_fault.bin");
+    EXPECT_EQ(static_cast<size_t>(c_fastRate * c_windowSeconds), fast.size());
+    EXPECT_EQ(static_cast<size_t>(c_defaultRate * c_windowSeconds), slow.size());
+}
+
+TEST_F(LoggerTest, FaultFileWithinDiskBudget)
+{
+    // The recorder holds more than the budget. The dump deletes the old segment to make room and
+    // stops at the budget instead of growing past it.
+    constexpr uint64_t c_budget = 16 * 1024;
+    m_config.m_diskBudget = c_budget;
+    {
+        Logger logger(m_config, false, false, true);
+        logger.SetFlightRecorder(10.0, 50.0, 1000);
+        int site = logger.RegisterSite("LoggerTest", __LINE__);
+
+        logger.openLog("old");
+        for (int i = 0; i < 100; i++)
+        {
+            logger.logMsg(eInfo, site, Text(60, 'a').c_str());
+        }
+        logger.closeLog();
+
+        logger.openLog("now");
+        LogDataT<ELoggerTestData> data(false, "");
+        for (int i = 0; i < 500; i++)
+        {
+            logger.logData(site, data);
+        }
+        logger.TriggerFlightRecorder("test");
+        logger.closeLog();
+    }
+
+    uint64_t faultSize = 0;
+    for (const std::string& path : Files())
+    {
+        EXPECT_EQ(std::string::npos, path.find("_old.")) << path;
+        struct stat st;
+        if (path.find("_fault.bin") != std::string::npos && stat(path.c_str(), &st) == 0)
+        {
+            faultSize = st.st_size;
+        }
+    }
+    EXPECT_GT(faultSize, 0u);
+    EXPECT_LT(faultSize, c_budget);
+
+    // The open segment is held to the budget when it flushes, the dump's own log line goes in after
+    EXPECT_LE(DirectorySize(), c_budget + LogRecord::c_msgSize);
+}
+
+TEST_F(LoggerTest, FuncLineSitesWhileRegistering)
+{
+    // The robot thread logs through the func/line overload while another thread registers sites.
+    // Each func/line pair gets one site and every line names it.
+    constexpr int c_lines = 3;
+    constexpr int c_messages = 200;
+    constexpr int c_registered = 60;
+    const char* func = __func__;
+    int sites[c_lines];
+    {
+        Logger logger(m_config, false, true);
+        logger.openLog("sites");
+
+        std::thread registrar([&]
+        {
+            for (int i = 0; i < c_registered; i++)
+            {
+                logger.RegisterSite("Registrar", i, std::to_string(i));
+            }
+        });
+        for (int i = 0; i < c_messages; i++)
+        {
+            logger.logMsg(eInfo, func, 1000 + i % c_lines, std::to_string(i % c_lines).c_str());
+        }
+        registrar.join();
+
+        for (int i = 0; i < c_lines; i++)
+        {
+            sites[i] = logger.RegisterSite("Other", i);
+        }
+        logger.closeLog();
+        EXPECT_EQ(0u, logger.GetDroppedRecords());
+    }
+
+    // Site,Id,Function,Line,Instance and Timestamp,Level,Site,Message
+    std::vector<int> lineOfSite;
+    int messages = 0;
+    for (const std::string& line : CsvLines())
+    {
+        char name[64];
+        int id;
+        int funcLine;
+        if (sscanf(line.c_str(), "Site,%d,%63[^,],%d", &id, name, &funcLine) == 3 && strcmp(name, func) == 0)
+        {
+            lineOfSite.resize(std::max<size_t>(lineOfSite.size(), id + 1), -1);
+            lineOfSite[id] = funcLine;
+            continue;
+        }
+
+        double timestamp;
+        char level;
+        int message;
+        if (sscanf(line.c_str(), "%lf,%c,%d,%d", &timestamp, &level, &id, &message) == 4)
+        {
+            ASSERT_LT(static_cast<size_t>(id), lineOfSite.size()) << line;
+            EXPECT_EQ(1000 + message, lineOfSite[id]) << line;
+            messages++;
+        }
+    }
+    EXPECT_EQ(c_messages, messages);
+    EXPECT_EQ(c_lines, std::count_if(lineOfSite.begin(), lineOfSite.end(), [](int line) { return line >= 0; }));
+
+    // Registration went on after the lookups, the ids kept counting from all of them
+    EXPECT_EQ(1 + c_registered + c_lines, sites[0]);
+    EXPECT_EQ(sites[0] + c_lines - 1, sites[c_lines - 1]);
+}
+
+TEST_F(LoggerTest, DISABLED_Benchmark)
+{
+    constexpr size_t c_iterations = 100000;
+    // A ten field ESwerveModuleLogData row as logData formats it
+    const char* row = "1.571,2.419,3.083,-12.750,0.000,-0.062,0.012,47.381,47.221,-0.313";
+
+    for (bool bAsync : { false, true })
+    {
+        Logger logger(m_config, false, bAsync);
+        int site = logger.RegisterSite("LoggerTest", __LINE__);
+        logger.openLog(bAsync ? "async" : "sync");
+
+        std::vector<double> latencies = Benchmark::CallLatencies(c_iterations, [&](size_t)
+        {
+            logger.logMsg(eInfo, site, row);
+        },
+        [&](size_t i)
+        {
+            // The writer drains every 5 ms, keep the rate below a ring per 5 ms so nothing drops
+            if (bAsync && i % 100 == 99)
+            {
+                usleep(1000);
+            }
+        });
+        Benchmark::Report(bAsync ? "Logger::logMsg async, 10 field row" : "Logger::logMsg sync, 10 field row", latencies);
+        if (bAsync)
+        {
+            printf("[  BENCH   ] %u records dropped\n", logger.GetDroppedRecords());
+        }
+
+        logger.closeLog();
+    }
+}
@@ -0,0 +1,173 @@
+/*
+    NumberFormat against printf, whose output it has to reproduce byte for byte, and the cost
+    of formatting a swerve module log row with each
+*/
+
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "Benchmark.h"
+#include "NumberFormat.h"
+
+namespace
+{
+    std::string Fixed3(double value)
+    {
+        char buffer[NumberFormat::c_maxDoubleChars + 1];
+        char* end = NumberFormat::FormatFixed3(buffer, value);
+        EXPECT_LE(static_cast<size_t>(end - buffer), NumberFormat::c_maxDoubleChars) << value;
+        return std::string(buffer, end);
+    }
+
+    std::string PrintfFixed3(double value)
+    {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), std::fabs(value) >= NumberFormat::c_fixedLimit ? "%.16e" : "%.3f", value);
+        return buffer;
+    }
+
+    std::string Int(int value, int width)
+    {
+        char buffer[NumberFormat::c_maxIntChars + 1];
+        char* end = NumberFormat::FormatInt(buffer, value, width);
+        return std::string(buffer, end);
+    }
+
+    std::string PrintfInt(int value, int width)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%*d", width, value);
+        return buffer;
+    }
+
+    void ExpectFixed3(double value)
+    {
+        ASSERT_EQ(PrintfFixed3(value), Fixed3(value)) << std::hexfloat << value;
+    }
+}
+
+TEST(NumberFormatTest, Fixed3EdgeValues)
+{
+    const double values[] =
+    {
+          0.0, -0.0, 0.0005, -0.0005, 0.0015, 0.0025, 0.9995, 0.9994999999999999, 1.0005
+        , 0.001, 0.999, 1.0, 123456.789, 2.5e-4, 4.9e-324, -4.9e-324, 2.2250738585072014e-308
+        , NumberFormat::c_kernelLimit, std::nextafter(NumberFormat::c_kernelLimit, 0.0), -NumberFormat::c_kernelLimit
+        , NumberFormat::c_fixedLimit, std::nextafter(NumberFormat::c_fixedLimit, 0.0), -NumberFormat::c_fixedLimit
+        , 1.0e300, -1.0e300, std::numeric_limits<double>::max(), std::numeric_limits<double>::lowest()
+        , std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()
+    };
+    for (double value : values)
+    {
+        ExpectFixed3(value);
+    }
+}
+
+TEST(NumberFormatTest, Fixed3NanHasNoSign)
+{
+    // printf writes "-nan" for a NaN with the sign bit set, the logger does not care
+    EXPECT_EQ("nan", Fixed3(std::numeric_limits<double>::quiet_NaN()));
+    EXPECT_EQ("nan", Fixed3(-std::numeric_limits<double>::quiet_NaN()));
+}
+
+TEST(NumberFormatTest, Fixed3HalfwayCasesRoundToEven)
+{
+    // k / 2^n with n up to 12 has the exact halfway cases of the third decimal
+    for (int n = 1; n <= 12; n++)
+    {
+        for (int k = -20000; k <= 20000; k++)
+        {
+            ExpectFixed3(std::ldexp(k, -n));
+        }
+    }
+}
+
+TEST(NumberFormatTest, Fixed3RandomValues)
+{
+    std::mt19937_64 rng(1);
+
+    // Sensor sized values, where the logger spends its time
+    std::uniform_real_distribution<double> small(-1000.0, 1000.0);
+    for (int i = 0; i < 1000000; i++)
+    {
+        ExpectFixed3(small(rng));
+    }
+
+    // Every magnitude, from random bit patterns
+    for (int i = 0; i < 1000000; i++)
+    {
+        uint64_t bits = rng();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        if (std::isnan(value))
+        {
+            continue;
+        }
+        ExpectFixed3(value);
+    }
+}
+
+TEST(NumberFormatTest, IntMatchesPrintf)
+{
+    const int values[] = { 0, 1, -1, 9, 10, -10, 99999, 100000, -99999, -100000, INT_MAX, INT_MIN, INT_MIN + 1 };
+    for (int width = 0; width <= static_cast<int>(NumberFormat::c_maxIntChars); width++)
+    {
+        for (int value : values)
+        {
+            ASSERT_EQ(PrintfInt(value, width), Int(value, width)) << value << " width " << width;
+        }
+    }
+
+    std::mt19937 rng(2);
+    std::uniform_int_distribution<int> dist(INT_MIN, INT_MAX);
+    for (int i = 0; i < 1000000; i++)
+    {
+        int value = dist(rng);
+        ASSERT_EQ(PrintfInt(value, 6), Int(value, 6)) << value;
+        ASSERT_EQ(PrintfInt(value, 0), Int(value, 0)) << value;
+    }
+}
+
+TEST(DISABLED_NumberFormatBenchmark, SwerveModuleLogRow)
+{
+    // The first ten ESwerveModuleLogData fields, as a module turning at speed would log them:
+    // desired angle, encoder volts, angle, rate, noise, min turn, frame error, NEO reference,
+    // NEO position, duty cycle
+    const double row[] = { 1.5707963, 2.4187, 3.0828, -12.75, 0.00042, -0.0617, 0.0123, 47.3814, 47.2207, -0.3125 };
+    constexpr size_t c_numFields = sizeof(row) / sizeof(row[0]);
+    constexpr size_t c_iterations = 500000;
+    char line[c_numFields * (NumberFormat::c_maxChars + 1) + 1];
+
+    Benchmark::Report("snprintf %.3f, 10 field row", Benchmark::NsPerCall(c_iterations, [&](size_t i)
+    {
+        char* out = line;
+        for (size_t f = 0; f < c_numFields; f++)
+        {
+            out += snprintf(out, line + sizeof(line) - out, f == 0 ? "%.3f" : ",%.3f", row[f] + i * 1e-9);
+        }
+        Benchmark::DoNotOptimize(line);
+    }));
+
+    Benchmark::Report("NumberFormat::FormatFixed3, 10 field row", Benchmark::NsPerCall(c_iterations, [&](size_t i)
+    {
+        char* out = line;
+        for (size_t f = 0; f < c_numFields; f++)
+        {
+            if (f > 0)
+            {
+                *out++ = ',';
+            }
+            out = NumberFormat::FormatFixed3(out, row[f] + i * 1e-9);
+        }
+        *out = '\0';
+        Benchmark::DoNotOptimize(line);
+    }));
+}
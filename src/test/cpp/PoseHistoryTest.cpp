@@ -0,0 +1,159 @@
+/*
+    PoseHistory: interpolation, rebasing onto a past measurement, and the cost of both
+*/
+
+#include <cmath>
+
+#include "gtest/gtest.h"
+
+#include "Benchmark.h"
+#include "PoseHistory.h"
+
+namespace
+{
+    using History = PoseHistory<4, 256>;
+    using Record = History::Record;
+
+    constexpr double c_period = 0.005;      //!< 200 Hz odometry
+    constexpr double c_speed = 1.0;         //!< Meters per second along x
+    constexpr double c_turnRate = 0.2;      //!< Radians per second
+
+    Record Driving(double t)
+    {
+        Record record{};
+        record.m_timestamp = t;
+        record.m_x = c_speed * t;
+        record.m_rotation = c_turnRate * t;
+        record.m_heading = c_turnRate * t;
+        return record;
+    }
+
+    /// Fills history with count records of Driving, c_period apart from t = 0
+    void Fill(History& history, int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            history.Push(Driving(i * c_period));
+        }
+    }
+}
+
+TEST(PoseHistoryTest, DropsOutOfOrderRecords)
+{
+    History history;
+    history.Push(Driving(1.0));
+    history.Push(Driving(0.5));
+    history.Push(Driving(1.0));
+
+    EXPECT_EQ(1u, history.Size());
+}
+
+TEST(PoseHistoryTest, KeepsTheNewestCapacityRecords)
+{
+    History history;
+    Fill(history, 400);
+
+    EXPECT_EQ(256u, history.Size());
+    EXPECT_DOUBLE_EQ(144 * c_period, history.Oldest().m_timestamp);
+    EXPECT_DOUBLE_EQ(399 * c_period, history.Newest().m_timestamp);
+}
+
+TEST(PoseHistoryTest, SampleInterpolates)
+{
+    History history;
+    Fill(history, 400);
+
+    Record sample;
+    ASSERT_TRUE(history.Sample(1.8025, sample));
+    EXPECT_NEAR(1.8025, sample.m_x, 1e-12);
+    EXPECT_NEAR(c_turnRate * 1.8025, sample.m_rotation, 1e-12);
+
+    EXPECT_FALSE(history.Sample(0.5, sample));
+
+    ASSERT_TRUE(history.Sample(10.0, sample));
+    EXPECT_DOUBLE_EQ(history.Newest().m_timestamp, sample.m_timestamp);
+}
+
+TEST(PoseHistoryTest, RebaseInsideTheHistory)
+{
+    History history;
+    Fill(history, 400);
+
+    double measured = 1.7;
+    double measuredRotation = c_turnRate * measured + 0.1;
+    ASSERT_TRUE(history.Rebase(measured, 2.0, 1.0, measuredRotation));
+
+    Record sample;
+    ASSERT_TRUE(history.Sample(measured, sample));
+    EXPECT_NEAR(2.0, sample.m_x, 1e-12);
+    EXPECT_NEAR(1.0, sample.m_y, 1e-12);
+    EXPECT_NEAR(measuredRotation, sample.m_rotation, 1e-12);
+
+    // Motion since the measurement is kept, turned by the rotation correction
+    const Record& newest = history.Newest();
+    double moved = c_speed * (newest.m_timestamp - measured);
+    EXPECT_NEAR(2.0 + moved * cos(0.1), newest.m_x, 1e-12);
+    EXPECT_NEAR(1.0 + moved * sin(0.1), newest.m_y, 1e-12);
+    EXPECT_NEAR(c_turnRate * newest.m_timestamp + 0.1, newest.m_rotation, 1e-12);
+
+    // Records before the measurement are left alone
+    ASSERT_TRUE(history.Sample(1.0, sample));
+    EXPECT_NEAR(1.0, sample.m_x, 1e-12);
+    EXPECT_NEAR(0.0, sample.m_y, 1e-12);
+}
+
+TEST(PoseHistoryTest, RebaseNewerThanTheHistoryMovesTheNewest)
+{
+    History history;
+    Fill(history, 400);
+    Record before = history.Newest();
+
+    ASSERT_TRUE(history.Rebase(before.m_timestamp + 0.02, 3.0, -1.0, 0.5));
+
+    const Record& newest = history.Newest();
+    EXPECT_DOUBLE_EQ(before.m_timestamp, newest.m_timestamp);
+    EXPECT_NEAR(3.0, newest.m_x, 1e-12);
+    EXPECT_NEAR(-1.0, newest.m_y, 1e-12);
+    EXPECT_NEAR(0.5, newest.m_rotation, 1e-12);
+    EXPECT_DOUBLE_EQ(before.m_heading, newest.m_heading);
+}
+
+TEST(PoseHistoryTest, RebaseOlderThanTheHistoryChangesNothing)
+{
+    History history;
+    Fill(history, 400);
+    Record before = history.Newest();
+
+    EXPECT_FALSE(history.Rebase(0.1, 3.0, -1.0, 0.5));
+    EXPECT_DOUBLE_EQ(before.m_x, history.Newest().m_x);
+    EXPECT_DOUBLE_EQ(before.m_y, history.Newest().m_y);
+
+    History empty;
+    EXPECT_FALSE(empty.Rebase(0.1, 3.0, -1.0, 0.5));
+}
+
+TEST(DISABLED_PoseHistoryBenchmark, PushAndSample)
+{
+    constexpr size_t c_iterations = 1000000;
+    History history;
+
+    Benchmark::Report("PoseHistory<4, 256>::Push", Benchmark::NsPerCall(c_iterations, [&](size_t i)
+    {
+        history.Push(Driving(i * c_period));
+    }));
+
+    // Spread over the whole ring so every query is a full binary search
+    double oldest = history.Oldest().m_timestamp;
+    double span = history.Newest().m_timestamp - oldest;
+    Record sample;
+    Benchmark::Report("PoseHistory<4, 256>::Sample", Benchmark::NsPerCall(c_iterations, [&](size_t i)
+    {
+        history.Sample(oldest + span * (i % 1021) / 1021.0, sample);
+        Benchmark::DoNotOptimize(sample);
+    }));
+
+    Benchmark::Report("PoseHistory<4, 256>::Rebase 50 ms back", Benchmark::NsPerCall(c_iterations / 10, [&](size_t)
+    {
+        history.Rebase(history.Newest().m_timestamp - 0.05, 1.0, 2.0, 0.3);
+    }));
+}
@@ -0,0 +1,31 @@
+/*
+    A Logger writing into a TempDirectory of its own, for tests of code that logs where
+    nothing reads the log back
+*/
+
+#pragma once
+
+#include "Logger.h"
+#include "TempDirectory.h"
+
+class ScratchLogger
+{
+public:
+    ScratchLogger()
+        : m_log(MakeConfig(m_directory), false)
+    {
+    }
+
+    Logger& Get() { return m_log; }
+
+private:
+    static LogStorage::Config MakeConfig(const TempDirectory& directory)
+    {
+        LogStorage::Config config;
+        config.m_directory = directory.GetPath();
+        return config;
+    }
+
+    TempDirectory m_directory;
+    Logger m_log;
+};
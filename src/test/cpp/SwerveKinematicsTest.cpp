@@ -0,0 +1,193 @@
+/*
+    SwerveKinematics against frc::SwerveDriveKinematics::ToSwerveModuleStates followed by
+    NormalizeWheelSpeeds, which it replaces in DriveSubsystem, and the cost of both
+*/
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <utility>
+
+#include <frc/geometry/Translation2d.h>
+#include <frc/kinematics/SwerveDriveKinematics.h>
+
+#include "gtest/gtest.h"
+
+#include "Benchmark.h"
+#include "Constants.h"
+#include "SwerveKinematics.h"
+
+namespace
+{
+    constexpr size_t c_numModules = DriveConstants::kNumSwerveModules;
+    using ModuleStates = SwerveKinematics<c_numModules>::ModuleStates;
+
+    constexpr double c_maxSpeed = AutoConstants::kMaxSpeed.to<double>();
+    constexpr double c_tolerance = 1e-12;
+
+    template <size_t... I>
+    frc::SwerveDriveKinematics<c_numModules> MakeReference(std::index_sequence<I...>)
+    {
+        return frc::SwerveDriveKinematics<c_numModules>
+        {
+            frc::Translation2d(units::meter_t(DriveConstants::kModuleConfigs[I].m_x), units::meter_t(DriveConstants::kModuleConfigs[I].m_y))...
+        };
+    }
+
+    class SwerveKinematicsTest : public ::testing::Test
+    {
+    protected:
+        ModuleStates Reference(const frc::ChassisSpeeds& speeds, double maxSpeed)
+        {
+            ModuleStates states = m_reference.ToSwerveModuleStates(speeds);
+            frc::SwerveDriveKinematics<c_numModules>::NormalizeWheelSpeeds(&states, units::meters_per_second_t(maxSpeed));
+            return states;
+        }
+
+        ModuleStates Fused(const frc::ChassisSpeeds& speeds, double maxSpeed)
+        {
+            ModuleStates states;
+            m_kinematics.ToSwerveModuleStates(speeds, maxSpeed, states);
+            return states;
+        }
+
+        void ExpectSame(const frc::ChassisSpeeds& speeds, double maxSpeed)
+        {
+            ModuleStates expected = Reference(speeds, maxSpeed);
+            ModuleStates actual = Fused(speeds, maxSpeed);
+            for (size_t i = 0; i < c_numModules; i++)
+            {
+                ASSERT_NEAR(expected[i].speed.to<double>(), actual[i].speed.to<double>(), c_tolerance)
+                    << "module " << i << " vx " << speeds.vx.to<double>() << " vy " << speeds.vy.to<double>() << " omega " << speeds.omega.to<double>();
+                ASSERT_NEAR(0.0, std::remainder(expected[i].angle.Radians().to<double>() - actual[i].angle.Radians().to<double>(), 2 * wpi::math::pi), c_tolerance)
+                    << "module " << i << " vx " << speeds.vx.to<double>() << " vy " << speeds.vy.to<double>() << " omega " << speeds.omega.to<double>();
+            }
+        }
+
+        static frc::ChassisSpeeds Speeds(double vx, double vy, double omega)
+        {
+            return { units::meters_per_second_t(vx), units::meters_per_second_t(vy), units::radians_per_second_t(omega) };
+        }
+
+        static double MaxModuleSpeed(const ModuleStates& states)
+        {
+            double max = 0.0;
+            for (const frc::SwerveModuleState& state : states)
+            {
+                max = std::max(max, std::fabs(state.speed.to<double>()));
+            }
+            return max;
+        }
+
+        frc::SwerveDriveKinematics<c_numModules> m_reference = MakeReference(std::make_index_sequence<c_numModules>());
+        SwerveKinematics<c_numModules> m_kinematics{DriveConstants::kModuleConfigs};
+    };
+}
+
+TEST_F(SwerveKinematicsTest, RandomSpeeds)
+{
+    std::mt19937_64 rng(1);
+    std::uniform_real_distribution<double> speed(-2.0, 2.0);
+    std::uniform_real_distribution<double> omega(-4.0, 4.0);
+
+    for (int i = 0; i < 1000000; i++)
+    {
+        ExpectSame(Speeds(speed(rng), speed(rng), omega(rng)), c_maxSpeed);
+    }
+}
+
+TEST_F(SwerveKinematicsTest, PureTranslationAndPureRotation)
+{
+    std::mt19937_64 rng(2);
+    std::uniform_real_distribution<double> dist(-2.0, 2.0);
+
+    for (int i = 0; i < 100000; i++)
+    {
+        ExpectSame(Speeds(dist(rng), dist(rng), 0.0), c_maxSpeed);
+        ExpectSame(Speeds(0.0, 0.0, dist(rng)), c_maxSpeed);
+    }
+}
+
+TEST_F(SwerveKinematicsTest, ZeroSpeed)
+{
+    ExpectSame(Speeds(0.0, 0.0, 0.0), c_maxSpeed);
+    ExpectSame(Speeds(-0.0, -0.0, -0.0), c_maxSpeed);
+
+    // Rotation2d(0, 0) is the zero angle, not atan2's NaN or signed zero cases
+    for (const frc::SwerveModuleState& state : Fused(Speeds(0.0, 0.0, 0.0), c_maxSpeed))
+    {
+        EXPECT_EQ(0.0, state.speed.to<double>());
+        EXPECT_EQ(0.0, state.angle.Radians().to<double>());
+    }
+    for (const frc::SwerveModuleState& state : Fused(Speeds(-0.0, -0.0, 0.0), c_maxSpeed))
+    {
+        EXPECT_EQ(0.0, state.angle.Radians().to<double>());
+    }
+
+    // Below Rotation2d's 1e-6 magnitude cutoff
+    ExpectSame(Speeds(1e-7, -1e-7, 0.0), c_maxSpeed);
+    ExpectSame(Speeds(0.0, 0.0, 1e-9), c_maxSpeed);
+}
+
+TEST_F(SwerveKinematicsTest, DesaturationBoundary)
+{
+    // Exactly at the limit nothing is scaled, a hair over it everything is
+    ModuleStates states = Fused(Speeds(c_maxSpeed, 0.0, 0.0), c_maxSpeed);
+    for (const frc::SwerveModuleState& state : states)
+    {
+        EXPECT_EQ(c_maxSpeed, state.speed.to<double>());
+    }
+    ExpectSame(Speeds(c_maxSpeed, 0.0, 0.0), c_maxSpeed);
+    ExpectSame(Speeds(std::nextafter(c_maxSpeed, 1.0), 0.0, 0.0), c_maxSpeed);
+    ExpectSame(Speeds(std::nextafter(c_maxSpeed, 0.0), 0.0, 0.0), c_maxSpeed);
+
+    // Spinning puts the corners over the limit while the chassis speed is under it
+    std::mt19937_64 rng(3);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    for (int i = 0; i < 100000; i++)
+    {
+        frc::ChassisSpeeds speeds = Speeds(dist(rng), dist(rng), 4.0 * dist(rng));
+        ExpectSame(speeds, c_maxSpeed);
+        EXPECT_LE(MaxModuleSpeed(Fused(speeds, c_maxSpeed)), c_maxSpeed * (1.0 + 1e-15));
+    }
+}
+
+TEST_F(SwerveKinematicsTest, DesaturateMatchesNormalizeWheelSpeeds)
+{
+    std::mt19937_64 rng(4);
+    std::uniform_real_distribution<double> dist(-2.0, 2.0);
+
+    for (int i = 0; i < 100000; i++)
+    {
+        ModuleStates expected = m_reference.ToSwerveModuleStates(Speeds(dist(rng), dist(rng), dist(rng)));
+        ModuleStates actual = expected;
+        frc::SwerveDriveKinematics<c_numModules>::NormalizeWheelSpeeds(&expected, units::meters_per_second_t(c_maxSpeed));
+        SwerveKinematics<c_numModules>::Desaturate(actual, c_maxSpeed);
+        for (size_t m = 0; m < c_numModules; m++)
+        {
+            ASSERT_NEAR(expected[m].speed.to<double>(), actual[m].speed.to<double>(), c_tolerance);
+        }
+    }
+}
+
+TEST_F(SwerveKinematicsTest, DISABLED_Benchmark)
+{
+    constexpr size_t c_iterations = 2000000;
+    frc::ChassisSpeeds speeds = Speeds(0.3, 0.2, 1.0);
+    ModuleStates states;
+
+    Benchmark::Report("SwerveDriveKinematics + NormalizeWheelSpeeds", Benchmark::NsPerCall(c_iterations, [&](size_t i)
+    {
+        speeds.vx = units::meters_per_second_t(0.3 + i * 1e-9);
+        states = m_reference.ToSwerveModuleStates(speeds);
+        frc::SwerveDriveKinematics<c_numModules>::NormalizeWheelSpeeds(&states, units::meters_per_second_t(c_maxSpeed));
+        Benchmark::DoNotOptimize(states);
+    }));
+    Benchmark::Report("SwerveKinematics::ToSwerveModuleStates", Benchmark::NsPerCall(c_iterations, [&](size_t i)
+    {
+        speeds.vx = units::meters_per_second_t(0.3 + i * 1e-9);
+        m_kinematics.ToSwerveModuleStates(speeds, c_maxSpeed, states);
+        Benchmark::DoNotOptimize(states);
+    }));
+}
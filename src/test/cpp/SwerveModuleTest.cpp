@@ -0,0 +1,178 @@
+/*
+    SwerveModuleT on the simulated hardware: a setpoint sent through SetDesiredState goes to
+    the Spark MAX loops, DrivetrainSim moves the wheels, and the module reads the same state
+    back from its sensors
+*/
+
+#include <array>
+#include <cmath>
+
+#include <frc/geometry/Rotation2d.h>
+#include <frc/kinematics/SwerveModuleState.h>
+
+#include "gtest/gtest.h"
+
+#include "AngleMath.h"
+#include "Constants.h"
+#include "ScratchLogger.h"
+#include "hardware/DrivetrainSim.h"
+#include "hardware/SimHardware.h"
+#include "subsystems/DriveSubsystem.h"
+#include "subsystems/SwerveModule.h"
+
+namespace
+{
+    constexpr size_t c_numModules = DriveConstants::kNumSwerveModules;
+    using Drive = DriveSubsystemT<SimHardware>;
+    using Module = SwerveModuleT<SimHardware>;
+
+    constexpr double c_speed = 1.0;                 // m/s
+    constexpr int c_settleLoops = 100;              // 2 s, a turn and the drive to speed take well under that
+
+    // How close the loops settle with the default gains: the turn P gain leaves the wheel about
+    // 0.11 rad short against steering friction, P plus feed forward drive about 5% fast
+    constexpr double c_angleTolerance = 0.15;       // Radians
+    constexpr double c_speedTolerance = 0.1;        // m/s
+
+    // How close the sensors read what the simulation did
+    constexpr double c_sensorTolerance = 0.02;
+
+    class SwerveModuleTest : public ::testing::Test
+    {
+    protected:
+        /// The modules and the World as DriveSubsystem builds them, without the rest of it
+        SwerveModuleTest()
+            : m_modules(Drive::MakeModules(m_log.Get()))
+            , m_gyro(0)
+            , m_world(Drive::GetModuleHardware(m_modules), Drive::GetModuleLocations(), m_gyro)
+        {
+        }
+
+        /// One robot loop with every module sent the same state, the way DriveSubsystem sends them
+        void Loop(double angle, double speed)
+        {
+            double timestamp = m_world.Step();
+            for (Module& module : m_modules)
+            {
+                module.Sample(timestamp);
+            }
+
+            frc::SwerveModuleState state{ units::meters_per_second_t(speed), frc::Rotation2d(units::radian_t(angle)) };
+            for (Module& module : m_modules)
+            {
+                bool bOutputReverse;
+                double minTurnRads = AngleMath::MinTurnRads(module.PrepareTurn(speed), angle, bOutputReverse);
+                module.SetDesiredState(state, minTurnRads, bOutputReverse);
+            }
+        }
+
+        void Run(double angle, double speed, int loops)
+        {
+            for (int i = 0; i < loops; i++)
+            {
+                Loop(angle, speed);
+            }
+        }
+
+        /// The module's state as it reads it, taking the wheel turned half way round with the
+        /// drive reversed as the same state
+        void ExpectState(size_t index, double angle, double speed)
+        {
+            frc::SwerveModuleState state = m_modules[index].GetState();
+            double measuredAngle = state.angle.Radians().to<double>();
+            double measuredSpeed = state.speed.to<double>();
+            double angleError = AngleMath::NegPiToPi(measuredAngle - angle);
+            if (fabs(angleError) > AngleMath::c_pi / 2)
+            {
+                angleError = AngleMath::NegPiToPi(angleError + AngleMath::c_pi);
+                measuredSpeed = -measuredSpeed;
+            }
+            EXPECT_NEAR(0.0, angleError, c_angleTolerance) << "module " << index;
+            EXPECT_NEAR(speed, measuredSpeed, c_speedTolerance) << "module " << index;
+
+            // The sensors agree with the wheel the simulation moved
+            double wheelAngle = m_modules[index].GetHardware().m_absEncoder.GetWheelAngle();
+            EXPECT_NEAR(0.0, AngleMath::NegPiToPi(measuredAngle - wheelAngle), c_sensorTolerance) << "module " << index;
+        }
+
+        ScratchLogger m_log;
+        Drive::Modules m_modules;
+        SimGyro m_gyro;
+        DrivetrainSim m_world;
+    };
+}
+
+TEST_F(SwerveModuleTest, SetpointRoundTrip)
+{
+    // Small and large turns, both ways, and ones that end with the drive reversed
+    const double angles[] = { 0.0, 0.5, 2.0, -2.5, AngleMath::c_pi, -0.3 };
+    for (double angle : angles)
+    {
+        Run(angle, c_speed, c_settleLoops);
+        for (size_t i = 0; i < c_numModules; i++)
+        {
+            ExpectState(i, angle, c_speed);
+        }
+
+        // All wheels pointing the same way move the chassis the way they read, without turning it
+        const DrivetrainSim::State& state = m_world.GetState();
+        frc::SwerveModuleState measured = m_modules[0].GetState();
+        double direction = state.m_heading + measured.angle.Radians().to<double>();
+        EXPECT_NEAR(measured.speed.to<double>() * cos(direction), state.m_vx, c_sensorTolerance) << "angle " << angle;
+        EXPECT_NEAR(measured.speed.to<double>() * sin(direction), state.m_vy, c_sensorTolerance) << "angle " << angle;
+        EXPECT_NEAR(0.0, state.m_omega, c_sensorTolerance) << "angle " << angle;
+    }
+}
+
+TEST_F(SwerveModuleTest, StopLeavesTheAngleAlone)
+{
+    constexpr double c_angle = 1.2;
+    Run(c_angle, c_speed, c_settleLoops);
+
+    // Asking for zero speed stops the drive and does not turn the wheels to the new angle
+    Run(0.0, 0.0, c_settleLoops);
+    for (size_t i = 0; i < c_numModules; i++)
+    {
+        ExpectState(i, c_angle, 0.0);
+    }
+
+    const DrivetrainSim::State& state = m_world.GetState();
+    EXPECT_NEAR(0.0, std::hypot(state.m_vx, state.m_vy), c_speedTolerance);
+}
+
+TEST_F(SwerveModuleTest, ResyncMovesReadStateToTheNewFrame)
+{
+    // Away from where any module's absolute encoder wraps, the angle rate there is too noisy to count as still
+    constexpr double c_angle = 1.5;
+    constexpr double c_slip = 0.2;                  // Radians, well over kTurnResyncThreshold
+    Run(c_angle, c_speed, c_settleLoops);
+    Run(0.0, 0.0, c_settleLoops);
+
+    // The NEO encoders slip, the wheels do not move
+    for (Module& module : m_modules)
+    {
+        auto& encoder = module.GetHardware().m_turnEncoder;
+        encoder.SetPosition(encoder.GetPosition() + c_slip);
+    }
+
+    // The modules resync while still. ReadState, which the odometry thread calls between loops,
+    // reads the wheel's angle before, during and after that.
+    for (int loop = 0; loop < 2 * ModuleConstants::kTurnResyncStillLoops; loop++)
+    {
+        Loop(0.0, 0.0);
+        for (size_t i = 0; i < c_numModules; i++)
+        {
+            double angle = m_modules[i].ReadState().angle.Radians().to<double>();
+            double wheelAngle = m_modules[i].GetHardware().m_absEncoder.GetWheelAngle();
+            EXPECT_NEAR(0.0, AngleMath::NegPiToPi(angle - wheelAngle), c_sensorTolerance) << "module " << i << " loop " << loop;
+        }
+    }
+
+    // And the NEO frame is back on the absolute angle
+    for (size_t i = 0; i < c_numModules; i++)
+    {
+        double neoAngle = m_modules[i].GetHardware().m_turnEncoder.GetPosition();
+        double wheelAngle = m_modules[i].GetHardware().m_absEncoder.GetWheelAngle();
+        EXPECT_NEAR(0.0, AngleMath::NegPiToPi(neoAngle - wheelAngle), ModuleConstants::kTurnResyncThreshold) << "module " << i;
+    }
+}
@@ -0,0 +1,62 @@
+/*
+    Scratch directory for tests that write files, e.g. a Logger's log directory.
+    Created empty, removed with whatever was written to it.
+*/
+
+#pragma once
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+class TempDirectory
+{
+public:
+    TempDirectory()
+    {
+        char path[] = "/tmp/frcUserProgramTestXXXXXX";
+        if (mkdtemp(path) != nullptr)
+        {
+            m_path = path;
+        }
+    }
+
+    ~TempDirectory()
+    {
+        for (const std::string& file : GetFiles())
+        {
+            unlink(file.c_str());
+        }
+        rmdir(m_path.c_str());
+    }
+
+    TempDirectory(const TempDirectory&) = delete;
+    TempDirectory& operator=(const TempDirectory&) = delete;
+
+    /// Empty if the directory could not be created
+    const std::string& GetPath() const { return m_path; }
+
+    /// Paths of the files in the directory, in no particular order
+    std::vector<std::string> GetFiles() const
+    {
+        std::vector<std::string> files;
+        if (DIR* dir = opendir(m_path.c_str()))
+        {
+            while (dirent* entry = readdir(dir))
+            {
+                if (entry->d_name[0] != '.')
+                {
+                    files.push_back(m_path + "/" + entry->d_name);
+                }
+            }
+            closedir(dir);
+        }
+        return files;
+    }
+
+private:
+    std::string m_path;
+};
@@ -0,0 +1,126 @@
+/*
+    TrajectoryCache: hits after a save, and regeneration of damaged entries
+*/
+
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <limits>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <frc/trajectory/TrajectoryConfig.h>
+
+#include "gtest/gtest.h"
+
+#include "TempDirectory.h"
+#include "TrajectoryCache.h"
+
+using namespace TrajectoryFile;
+
+namespace
+{
+    class TrajectoryCacheTest : public ::testing::Test
+    {
+    protected:
+        void SetUp() override
+        {
+            ASSERT_FALSE(m_directory.GetPath().empty());
+            m_path = m_directory.GetPath() + "/trajectories.bin";
+        }
+
+        /// Gets the one test trajectory through a cache opened on the file, then saves it
+        frc::Trajectory GetAndSave(unsigned& hits)
+        {
+            TrajectoryCache cache(m_path);
+            frc::Trajectory trajectory = cache.Get(
+                frc::Pose2d(units::meter_t(0), units::meter_t(0), frc::Rotation2d(units::radian_t(0))),
+                { frc::Translation2d(units::meter_t(1), units::meter_t(1)) },
+                frc::Pose2d(units::meter_t(3), units::meter_t(0), frc::Rotation2d(units::radian_t(0))),
+                frc::TrajectoryConfig(units::meters_per_second_t(1.0), units::meters_per_second_squared_t(1.0)));
+            EXPECT_TRUE(cache.Save());
+            hits = cache.GetHits();
+            return trajectory;
+        }
+
+        /// Overwrites part of the file, offset in bytes
+        void Patch(size_t offset, const void* data, size_t len)
+        {
+            int fd = open(m_path.c_str(), O_WRONLY);
+            ASSERT_GE(fd, 0);
+            ASSERT_EQ(static_cast<ssize_t>(len), pwrite(fd, data, len, offset));
+            close(fd);
+        }
+
+        /// Offset of the t of the state at index, in a file of one trajectory
+        static size_t StateTimeOffset(size_t index)
+        {
+            return sizeof(Header) + sizeof(Entry) + index * sizeof(State) + offsetof(State, m_t);
+        }
+
+        static void ExpectSame(const frc::Trajectory& expected, const frc::Trajectory& actual)
+        {
+            ASSERT_EQ(expected.States().size(), actual.States().size());
+            for (size_t i = 0; i < expected.States().size(); i++)
+            {
+                EXPECT_EQ(expected.States()[i].t.to<double>(), actual.States()[i].t.to<double>());
+                EXPECT_EQ(expected.States()[i].pose.Translation().X().to<double>(), actual.States()[i].pose.Translation().X().to<double>());
+            }
+        }
+
+        TempDirectory m_directory;
+        std::string m_path;
+    };
+}
+
+TEST_F(TrajectoryCacheTest, HitAfterSave)
+{
+    unsigned hits;
+    frc::Trajectory generated = GetAndSave(hits);
+    EXPECT_EQ(0u, hits);
+    ASSERT_GT(generated.States().size(), 2u);
+
+    frc::Trajectory cached = GetAndSave(hits);
+    EXPECT_EQ(1u, hits);
+    ExpectSame(generated, cached);
+}
+
+TEST_F(TrajectoryCacheTest, RegeneratesEntryWithoutStates)
+{
+    unsigned hits;
+    frc::Trajectory generated = GetAndSave(hits);
+
+    uint32_t numStates = 0;
+    Patch(sizeof(Header) + offsetof(Entry, m_numStates), &numStates, sizeof(numStates));
+
+    ExpectSame(generated, GetAndSave(hits));
+    EXPECT_EQ(0u, hits);
+    GetAndSave(hits);
+    EXPECT_EQ(1u, hits);
+}
+
+TEST_F(TrajectoryCacheTest, RegeneratesEntryWithNonFiniteTime)
+{
+    unsigned hits;
+    frc::Trajectory generated = GetAndSave(hits);
+
+    double t = std::numeric_limits<double>::quiet_NaN();
+    Patch(StateTimeOffset(1), &t, sizeof(t));
+
+    ExpectSame(generated, GetAndSave(hits));
+    EXPECT_EQ(0u, hits);
+}
+
+TEST_F(TrajectoryCacheTest, RegeneratesEntryWithTimeGoingBackwards)
+{
+    unsigned hits;
+    frc::Trajectory generated = GetAndSave(hits);
+
+    double t = generated.States()[0].t.to<double>();
+    Patch(StateTimeOffset(2), &t, sizeof(t));
+
+    ExpectSame(generated, GetAndSave(hits));
+    EXPECT_EQ(0u, hits);
+}
@@ -0,0 +1,218 @@
+/*
+    LogToCsv
+    Host side converter for the binary LogDataT log (see BinaryLogFormat.h)
+
+    Writes one CSV per stream, one column per field, with the timestamp in seconds
+    in the first column.
+
+    Build:  g++ -std=c++17 -O2 -I../../src/main/include LogToCsv.cpp -o LogToCsv
+    Usage:  LogToCsv logfile.bin [output prefix]
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "BinaryLogFormat.h"
+
+struct Stream
+{
+    std::string m_name;
+    std::vector<std::string> m_fieldNames;
+    int m_numInts = 0;
+    int m_numDoubles = 0;
+    FILE* m_out = nullptr;
+};
+
+class Reader
+{
+public:
+    explicit Reader(FILE* fd) : m_fd(fd) {}
+
+    bool Read(void* dst, size_t size) { return fread(dst, 1, size, m_fd) == size; }
+
+    bool ReadU16(uint16_t& value) { return Read(&value, sizeof(value)); }
+
+    bool ReadString(std::string& str)
+    {
+        uint16_t len;
+        if (!ReadU16(len))
+            return false;
+        str.resize(len);
+        return len == 0 || Read(&str[0], len);
+    }
+
+private:
+    FILE* m_fd;
+};
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s logfile.bin [output prefix]\n", argv[0]);
+        return 1;
+    }
+
+    FILE* in = fopen(argv[1], "rb");
+    if (in == nullptr)
+    {
+        fprintf(stderr, "Cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    std::string prefix = argc > 2 ? argv[2] : "log";
+    Reader reader(in);
+
+    std::map<uint16_t, Stream> streams;             // Stream id -> stream, for the current segment
+    std::map<std::string, FILE*> outputs;           // Output files are shared by segments with the same stream layout
+    std::vector<unsigned char> payload;
+    int segments = 0;
+    long records = 0;
+
+    int tag;
+    while ((tag = fgetc(in)) != EOF)
+    {
+        if (tag == BinaryLog::c_magic[0])
+        {
+            char magic[sizeof(BinaryLog::c_magic)];
+            uint32_t version;
+            magic[0] = tag;
+            if (!reader.Read(magic + 1, sizeof(magic) - 1) || memcmp(magic, BinaryLog::c_magic, sizeof(magic)) != 0
+             || !reader.Read(&version, sizeof(version)))
+            {
+                fprintf(stderr, "Bad segment header at offset %ld\n", ftell(in));
+                break;
+            }
+            if (version != BinaryLog::c_version)
+            {
+                fprintf(stderr, "Unsupported version %u\n", version);
+                break;
+            }
+            streams.clear();
+            segments++;
+        }
+        else if (tag == BinaryLog::c_tagSchema)
+        {
+            uint16_t id, numInts, numDoubles;
+            Stream stream;
+            if (!reader.ReadU16(id) || !reader.ReadU16(numInts) || !reader.ReadU16(numDoubles) || !reader.ReadString(stream.m_name))
+            {
+                fprintf(stderr, "Truncated schema\n");
+                break;
+            }
+            stream.m_numInts = numInts;
+            stream.m_numDoubles = numDoubles;
+            stream.m_fieldNames.resize(numInts + numDoubles);
+            bool bOk = true;
+            for (auto& name : stream.m_fieldNames)
+            {
+                bOk = bOk && reader.ReadString(name);
+            }
+            if (!bOk)
+            {
+                fprintf(stderr, "Truncated schema\n");
+                break;
+            }
+
+            std::string header = "Timestamp";
+            for (auto& name : stream.m_fieldNames)
+            {
+                header += "," + name;
+            }
+
+            // Same name and columns as an earlier segment: keep appending to that file
+            std::string key = stream.m_name + "\n" + header;
+            auto it = outputs.find(key);
+            if (it == outputs.end())
+            {
+                std::string fileName = prefix + "_" + stream.m_name;
+                for (auto& c : fileName)
+                {
+                    if (c == ':' || c == ' ' || c == '/' || c == '[' || c == ']')
+                        c = '_';
+                }
+                int count = 0;
+                for (auto& o : outputs)
+                {
+                    count += o.first.compare(0, stream.m_name.size() + 1, stream.m_name + "\n") == 0;
+                }
+                if (count > 0)
+                {
+                    fileName += "_" + std::to_string(count);
+                }
+                fileName += ".csv";
+
+                FILE* out = fopen(fileName.c_str(), "w");
+                if (out == nullptr)
+                {
+                    fprintf(stderr, "Cannot create %s\n", fileName.c_str());
+                    break;
+                }
+                fprintf(out, "%s\n", header.c_str());
+                it = outputs.emplace(key, out).first;
+            }
+            stream.m_out = it->second;
+            streams[id] = stream;
+        }
+        else if (tag == BinaryLog::c_tagRecord)
+        {
+            uint16_t id;
+            int64_t timestampUs;
+            if (!reader.ReadU16(id) || !reader.Read(&timestampUs, sizeof(timestampUs)))
+            {
+                fprintf(stderr, "Truncated record\n");
+                break;
+            }
+            auto it = streams.find(id);
+            if (it == streams.end())
+            {
+                fprintf(stderr, "Record for unknown stream %u\n", id);
+                break;
+            }
+            Stream& stream = it->second;
+            payload.resize(BinaryLog::PayloadSize(stream.m_numInts, stream.m_numDoubles));
+            if (!payload.empty() && !reader.Read(payload.data(), payload.size()))
+            {
+                fprintf(stderr, "Truncated record\n");
+                break;
+            }
+
+            fprintf(stream.m_out, "%.6f", timestampUs * 1.0e-6);
+            const unsigned char* p = payload.data();
+            for (int i = 0; i < stream.m_numInts; i++)
+            {
+                int32_t value;
+                memcpy(&value, p, sizeof(value));
+                p += sizeof(value);
+                fprintf(stream.m_out, ",%d", value);
+            }
+            for (int i = 0; i < stream.m_numDoubles; i++)
+            {
+                double value;
+                memcpy(&value, p, sizeof(value));
+                p += sizeof(value);
+                fprintf(stream.m_out, ",%.17g", value);
+            }
+            fputc('\n', stream.m_out);
+            records++;
+        }
+        else
+        {
+            fprintf(stderr, "Unknown block tag %d at offset %ld\n", tag, ftell(in) - 1);
+            break;
+        }
+    }
+
+    for (auto& o : outputs)
+    {
+        fclose(o.second);
+    }
+    fclose(in);
+
+    printf("%d segments, %zu output files, %ld records\n", segments, outputs.size(), records);
+
+    return 0;
+}